@@ -23,6 +23,7 @@ int main()
     app.port(18080)
       .use_compression(crow::compression::algorithm::DEFLATE)
       //.use_compression(crow::compression::algorithm::GZIP)
+      //.use_compression({crow::compression::algorithm::BROTLI, crow::compression::algorithm::GZIP}) // needs CROW_ENABLE_BROTLI
       .loglevel(crow::LogLevel::Debug)
       .multithreaded()
       .run();
@@ -1,11 +1,14 @@
 #pragma once
 #include "crow/query_string.h"
 #include "crow/http_parser_merged.h"
+#include "crow/http_parser_fast.h"
 #include "crow/ci_map.h"
 #include "crow/TinySHA1.hpp"
 #include "crow/settings.h"
 #include "crow/socket_adaptors.h"
 #include "crow/socket_acceptors.h"
+#include "crow/socket_handoff.h"
+#include "crow/cpu_affinity.h"
 #include "crow/json.h"
 #include "crow/mustache.h"
 #include "crow/logging.h"
@@ -14,6 +17,7 @@
 #include "crow/common.h"
 #include "crow/http_request.h"
 #include "crow/websocket.h"
+#include "crow/sse.h"
 #include "crow/parser.h"
 #include "crow/http_response.h"
 #include "crow/multipart.h"
@@ -22,6 +26,11 @@
 #include "crow/middleware.h"
 #include "crow/middleware_context.h"
 #include "crow/compression.h"
+#include "crow/connection_pool.h"
+#include "crow/request_arena.h"
+#include "crow/load_balancing.h"
+#include "crow/admission_control.h"
+#include "crow/handler_pool.h"
 #include "crow/http_connection.h"
 #include "crow/http_server.h"
 #include "crow/app.h"
@@ -0,0 +1,249 @@
+#pragma once
+
+#ifdef CROW_USE_BOOST
+#include <boost/asio.hpp>
+#else
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include <asio.hpp>
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "crow/load_balancing.h"
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+#ifdef CROW_USE_BOOST
+    namespace asio = boost::asio;
+    using error_code = boost::system::error_code;
+#else
+    using error_code = asio::error_code;
+#endif
+
+    /// What happens to connections and requests over one of the server's limits.
+    enum class shed_action
+    {
+        /// Answer `503 Service Unavailable` with a `Retry-After` header and close the connection.
+        service_unavailable,
+        /// Close the connection without answering.
+        close,
+    };
+
+    /// Connections and requests turned away since the server started, by the limit they were over.
+    struct shed_stats
+    {
+        std::uint64_t connections{};        ///< Over \ref Crow::max_connections().
+        std::uint64_t worker_connections{}; ///< Over \ref Crow::max_connections_per_worker().
+        std::uint64_t ip_connections{};     ///< Over \ref Crow::max_connections_per_ip().
+        std::uint64_t requests{};           ///< Over \ref Crow::max_requests_in_flight().
+    };
+
+    namespace detail
+    {
+        /// Limits on what a server takes on, 0 meaning unlimited.
+        struct admission_limits
+        {
+            size_t connections = 0;
+            size_t connections_per_worker = 0;
+            size_t connections_per_ip = 0;
+            size_t requests_in_flight = 0;
+            shed_action action = shed_action::service_unavailable;
+            std::chrono::seconds retry_after{1};
+
+            bool any() const
+            {
+                return connections || connections_per_worker || connections_per_ip || requests_in_flight;
+            }
+        };
+
+        /// Decides whether new connections and requests are served, shared by the server's threads.
+
+        ///
+        /// The limits are soft: connections or requests arriving on several threads at once may overshoot them slightly.
+        class admission_control
+        {
+        public:
+            explicit admission_control(const std::vector<worker_load_counters>& workers):
+              workers_(workers)
+            {}
+
+            /// Set the limits, before the server starts.
+            void limits(const admission_limits& limits)
+            {
+                limits_ = limits;
+                shed_response_.clear();
+                if (limits_.action == shed_action::service_unavailable)
+                {
+                    shed_response_ = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: " + std::to_string(limits_.retry_after.count()) +
+                                     "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                }
+            }
+
+            /// Whether any limit is set, none of the other functions need to be called otherwise.
+            bool enabled() const
+            {
+                return limits_.any();
+            }
+
+            /// The bytes to send to a connection that is turned away, empty to just close it.
+            const std::string& shed_response() const
+            {
+                return shed_response_;
+            }
+
+            /// Count in a new connection handled by `worker` (already counted in the worker's load), unless it's over a limit.
+
+            ///
+            /// `address` is the client's, `nullptr` for connections not coming over IP.
+            /// Every admitted connection has to be counted out with \ref connection_closed().
+            bool admit_connection(size_t worker, const asio::ip::address* address)
+            {
+                if (limits_.connections_per_worker && workers_[worker].connections > limits_.connections_per_worker)
+                {
+                    shed_.worker_connections++;
+                    return false;
+                }
+                if (limits_.connections && connections_.fetch_add(1) >= limits_.connections)
+                {
+                    connections_--;
+                    shed_.connections++;
+                    return false;
+                }
+                if (limits_.connections_per_ip && address)
+                {
+                    std::lock_guard<std::mutex> lock(ip_mutex_);
+                    auto& count = ip_connections_[*address];
+                    if (count >= limits_.connections_per_ip)
+                    {
+                        if (limits_.connections)
+                            connections_--;
+                        shed_.ip_connections++;
+                        return false;
+                    }
+                    count++;
+                }
+                return true;
+            }
+
+            void connection_closed(const asio::ip::address* address)
+            {
+                if (limits_.connections)
+                    connections_--;
+                if (limits_.connections_per_ip && address)
+                {
+                    std::lock_guard<std::mutex> lock(ip_mutex_);
+                    auto it = ip_connections_.find(*address);
+                    if (it != ip_connections_.end() && --it->second == 0)
+                        ip_connections_.erase(it);
+                }
+            }
+
+            /// Whether a new request can be handled, called before it's parsed.
+            bool admit_request()
+            {
+                if (!limits_.requests_in_flight)
+                    return true;
+                size_t in_flight = 0;
+                for (auto& worker : workers_)
+                    in_flight += worker.pending_requests;
+                if (in_flight < limits_.requests_in_flight)
+                    return true;
+                shed_.requests++;
+                return false;
+            }
+
+            shed_stats stats() const
+            {
+                return {shed_.connections, shed_.worker_connections, shed_.ip_connections, shed_.requests};
+            }
+
+        private:
+            struct counters
+            {
+                std::atomic<std::uint64_t> connections{0};
+                std::atomic<std::uint64_t> worker_connections{0};
+                std::atomic<std::uint64_t> ip_connections{0};
+                std::atomic<std::uint64_t> requests{0};
+            };
+
+            const std::vector<worker_load_counters>& workers_;
+            admission_limits limits_;
+            std::string shed_response_;
+            std::atomic<size_t> connections_{0};
+            std::mutex ip_mutex_;
+            std::map<asio::ip::address, size_t> ip_connections_;
+            counters shed_;
+        };
+
+        /// Send `response` to a connection that is turned away and close it, without allocating a \ref Connection for it.
+
+        ///
+        /// What the client sends is then read and dropped, as closing a socket with unread data resets the connection (and the client may lose the response).
+        /// The socket is closed after the client closes its end, or after a second at most. With an empty `response` the socket is closed right away.
+        template<typename Socket>
+        void shed_connection(Socket socket, const std::string& response)
+        {
+            error_code ec;
+            if (response.empty())
+            {
+                socket.close(ec);
+                return;
+            }
+
+            struct state
+            {
+                state(Socket&& s):
+                  socket(std::move(s)), timer(socket.get_executor())
+                {}
+
+                void discard(const std::shared_ptr<state>& self)
+                {
+                    socket.async_read_some(asio::buffer(buffer), [self](const error_code& ec, std::size_t) {
+                        if (ec)
+                        {
+                            error_code ignored;
+                            self->socket.close(ignored);
+                            self->timer.cancel();
+                            return;
+                        }
+                        self->discard(self);
+                    });
+                }
+
+                Socket socket;
+                asio::steady_timer timer;
+                std::array<char, 512> buffer;
+            };
+
+            auto s = std::make_shared<state>(std::move(socket));
+            s->timer.expires_after(std::chrono::seconds(1));
+            s->timer.async_wait([s](const error_code& wait_ec) {
+                if (wait_ec)
+                    return;
+                error_code ignored;
+                s->socket.close(ignored);
+            });
+            asio::async_write(s->socket, asio::buffer(response), [s](const error_code& write_ec, std::size_t) {
+                error_code ignored;
+                if (write_ec)
+                {
+                    s->socket.close(ignored);
+                    s->timer.cancel();
+                    return;
+                }
+                s->socket.shutdown(asio::socket_base::shutdown_send, ignored);
+                s->discard(s);
+            });
+        }
+    } // namespace detail
+} // namespace crow
@@ -10,6 +10,7 @@
  * - \ref CROW_ROUTE
  * - \ref CROW_BP_ROUTE
  * - \ref CROW_WEBSOCKET_ROUTE
+ * - \ref CROW_SSE_ROUTE
  * - \ref CROW_MIDDLEWARES
  * - \ref CROW_CATCHALL_ROUTE
  * - \ref CROW_BP_CATCHALL_ROUTE
@@ -24,6 +25,8 @@
 #include <future>
 #include <cstdint>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 #include <thread>
 #include <condition_variable>
 
@@ -35,6 +38,9 @@
 #include "crow/middleware_context.h"
 #include "crow/http_request.h"
 #include "crow/http_server.h"
+#include "crow/handler_pool.h"
+#include "crow/socket_handoff.h"
+#include "crow/static_file_cache.h"
 #include "crow/task_timer.h"
 #include "crow/websocket.h"
 #ifdef CROW_ENABLE_COMPRESSION
@@ -137,6 +143,32 @@
  */
 #define CROW_WEBSOCKET_ROUTE(app, url) app.route<crow::black_magic::get_parameter_tag(url)>(url).websocket<std::remove_reference<decltype(app)>::type>(&app)
 
+/**
+ * \def CROW_SSE_ROUTE(app, url)
+ * \brief Defines a Server-Sent Events route for app.
+ *
+ * The connection is kept open and events are pushed to the client
+ * through a \ref crow::sse::connection. The usage syntax of this macro is
+ * like this:
+ *
+ * ```cpp
+ * auto app = crow::SimpleApp(); // or crow::App()
+ * CROW_SSE_ROUTE(app, "/events")
+ *     .onopen([&](crow::sse::connection& conn){
+ *                subscribe(&conn, conn.last_event_id());
+ *            })
+ *     .onclose([&](crow::sse::connection& conn){
+ *                 unsubscribe(&conn);
+ *             });
+ *
+ * // later, from any thread
+ * conn->send_event("42", "update", "some data");
+ * ```
+ *
+ * \see [Page of the guide "Server-Sent Events"](https://crowcpp.org/master/guides/sse/).
+ */
+#define CROW_SSE_ROUTE(app, url) app.route<crow::black_magic::get_parameter_tag(url)>(url).sse<std::remove_reference<decltype(app)>::type>(&app)
+
 /**
  * \def CROW_MIDDLEWARES(app, ...)
  * \brief Enable a Middleware for an specific route in app
@@ -250,6 +282,9 @@ namespace crow
         ///
         using WebSocketRule_t = WebSocketRule<Crow<Middlewares...>>;
 
+        /// \brief Server-Sent Events rule type used in this application.
+        using SSERule_t = SSERule<Crow<Middlewares...>>;
+
         Crow()
         {}
 
@@ -274,12 +309,45 @@ namespace crow
             return router_.handle_initial(req, res);
         }
 
+        /// \brief Process only the method and URL of a request into `found`, whose params can draw from a connection's arena
+        void handle_initial(request& req, response& res, routing_handle_result& found)
+        {
+            router_.handle_initial(req, res, found);
+        }
+
+        /// \brief Whether the route found for a request receives the request body while it arrives
+        bool streams_body(const routing_handle_result& found)
+        {
+            return router_.streams_body(found);
+        }
+
+        /// \brief Whether the handler of the route found for a request runs on the handler thread pool
+        bool offloads_handler(const routing_handle_result& found)
+        {
+            return router_.offloads_handler(found);
+        }
+
+        /// \brief Run a task on the handler thread pool (or right away if there is none)
+        void offload(std::function<void()> task)
+        {
+            if (handler_pool_)
+                handler_pool_->post(std::move(task));
+            else
+                task();
+        }
+
         /// \brief Process the fully parsed request and generate a response for it
         void handle(request& req, response& res, std::unique_ptr<routing_handle_result>& found)
         {
             router_.handle<self_t>(req, res, *found);
         }
 
+        /// \brief Process the fully parsed request and generate a response for it
+        void handle(request& req, response& res, const routing_handle_result& found)
+        {
+            router_.handle<self_t>(req, res, found);
+        }
+
         /// \brief Process a fully parsed request from start to finish (primarily used for debugging)
         void handle_full(request& req, response& res)
         {
@@ -443,6 +511,43 @@ namespace crow
             return bindaddr_;
         }
 
+        /// \brief Accept connections on `fd`, a socket that is already bound and listening (e.g. passed down by a parent process), instead of binding to \ref bindaddr() and \ref port()
+        ///
+        /// The server takes ownership of the socket and closes it when it stops. The socket is a TCP one, or a Unix one together with \ref local_socket_path().
+        self_t& listen_fd(int fd)
+        {
+            listen_fd_ = fd;
+            return *this;
+        }
+
+        /// \brief Get the inherited listening socket the server will use (`-1` if it binds its own)
+        int listen_fd() const
+        {
+            return listen_fd_;
+        }
+
+        /// \brief Use the listening socket passed by systemd socket activation (`LISTEN_FDS`), if the process was started that way
+        ///
+        /// Otherwise the server binds to \ref bindaddr() and \ref port() as usual. Only the first socket is used.
+        self_t& systemd_socket_activation(bool enabled = true)
+        {
+            systemd_socket_activation_ = enabled;
+            return *this;
+        }
+
+        /// \brief Hand the listening socket over from one process to the next through the Unix socket at `path`
+        ///
+        /// When starting, the server asks the process already serving `path` for its listening socket, and binds its own if there is none.
+        /// It then serves `path` itself: once a new process takes its listening socket, the server drains (see \ref drain()) for up to `drain_timeout` and stops.
+        /// Both processes accept connections on the same socket meanwhile, so none is refused during a restart.
+        /// Only processes of the same user can take the socket, `path` should still be in a directory others can't write to. Not supported on Windows.
+        self_t& socket_handoff(std::string path, std::chrono::milliseconds drain_timeout = std::chrono::seconds(30))
+        {
+            handoff_path_ = std::move(path);
+            handoff_drain_timeout_ = drain_timeout;
+            return *this;
+        }
+
         /// \brief Run the server on multiple threads using all available threads
         self_t& multithreaded()
         {
@@ -464,6 +569,211 @@ namespace crow
             return concurrency_;
         }
 
+        /// \brief Let every worker thread accept connections on its own `SO_REUSEPORT` socket
+        ///
+        /// The kernel spreads new connections between the workers, and a connection stays on the thread that accepted it
+        /// (by default, a single thread accepts every connection and hands it over to the least busy worker).
+        /// Only affects TCP (and SSL) servers on platforms supporting `SO_REUSEPORT` (e.g. Linux).
+        self_t& reuse_port(bool enabled = true)
+        {
+            reuse_port_ = enabled;
+            return *this;
+        }
+
+        /// \brief Pin the worker threads to CPUs, worker `i` runs on `cpus[i % cpus.size()]`
+        ///
+        /// Each worker allocates its own state after being pinned, so that it lives on the worker's NUMA node.
+        /// Together with \ref reuse_port(), every worker's socket also asks the kernel (`SO_INCOMING_CPU`, Linux only) for the connections whose packets arrive on its CPU.
+        /// The CPUs the workers end up on are in the startup log.
+        self_t& worker_cpus(std::vector<int> cpus)
+        {
+            worker_cpus_ = std::move(cpus);
+            return *this;
+        }
+
+        /// \brief Get the CPUs the worker threads are pinned to (empty if they aren't)
+        const std::vector<int>& worker_cpus() const
+        {
+            return worker_cpus_;
+        }
+
+        /// \brief Pin the thread accepting new connections to a CPU (`-1` to leave it unpinned)
+        self_t& acceptor_cpu(int cpu)
+        {
+            acceptor_cpu_ = cpu;
+            return *this;
+        }
+
+        /// \brief Get the CPU the thread accepting new connections is pinned to (`-1` if it isn't)
+        int acceptor_cpu() const
+        {
+            return acceptor_cpu_;
+        }
+
+        /// \brief Set how new connections are spread between the worker threads
+        ///
+        /// - crow::load_balancing::least_connections (default): the worker with the fewest open connections
+        /// - crow::load_balancing::round_robin: every worker in turn
+        /// - crow::load_balancing::power_of_two_choices: the less busy of two random workers, based on the requests each one is handling and how long its requests take on average
+        ///
+        /// Has no effect together with \ref reuse_port(), where the kernel picks the worker.
+        self_t& load_balancing(crow::load_balancing strategy)
+        {
+            load_balancing_ = strategy;
+            return *this;
+        }
+
+        /// \brief Get how new connections are spread between the worker threads
+        crow::load_balancing load_balancing() const
+        {
+            return load_balancing_;
+        }
+
+        /// \brief Get the current load of every worker thread (empty if the server isn't running)
+        std::vector<worker_load> worker_loads() const
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_server_)
+                return ssl_server_->worker_loads();
+#endif
+            if (server_)
+                return server_->worker_loads();
+            if (unix_server_)
+                return unix_server_->worker_loads();
+            return {};
+        }
+
+        /// \brief Limit the open connections on the whole server (0, the default, for no limit)
+        ///
+        /// Connections over the limit are turned away right after being accepted, see \ref shed_action().
+        self_t& max_connections(size_t connections)
+        {
+            admission_limits_.connections = connections;
+            return *this;
+        }
+
+        /// \brief Get the limit of open connections on the whole server (0 if there is none)
+        size_t max_connections() const
+        {
+            return admission_limits_.connections;
+        }
+
+        /// \brief Limit the open connections on any single worker thread (0, the default, for no limit)
+        self_t& max_connections_per_worker(size_t connections)
+        {
+            admission_limits_.connections_per_worker = connections;
+            return *this;
+        }
+
+        /// \brief Get the limit of open connections on any single worker thread (0 if there is none)
+        size_t max_connections_per_worker() const
+        {
+            return admission_limits_.connections_per_worker;
+        }
+
+        /// \brief Limit the open connections from a single client IP address (0, the default, for no limit)
+        self_t& max_connections_per_ip(size_t connections)
+        {
+            admission_limits_.connections_per_ip = connections;
+            return *this;
+        }
+
+        /// \brief Get the limit of open connections from a single client IP address (0 if there is none)
+        size_t max_connections_per_ip() const
+        {
+            return admission_limits_.connections_per_ip;
+        }
+
+        /// \brief Limit the requests being handled at once on the whole server (0, the default, for no limit)
+        ///
+        /// A request arriving over the limit is turned away before being parsed, together with its connection, see \ref shed_action().
+        self_t& max_requests_in_flight(size_t requests)
+        {
+            admission_limits_.requests_in_flight = requests;
+            return *this;
+        }
+
+        /// \brief Get the limit of requests being handled at once (0 if there is none)
+        size_t max_requests_in_flight() const
+        {
+            return admission_limits_.requests_in_flight;
+        }
+
+        /// \brief Set what happens to connections and requests over one of the limits
+        ///
+        /// - crow::shed_action::service_unavailable (default): a canned `503 Service Unavailable` response with a `Retry-After: <retry_after>` header, then the connection is closed
+        /// - crow::shed_action::close: the connection is closed without a response
+        ///
+        /// HTTPS connections turned away are always just closed, as answering would need a TLS handshake.
+        self_t& shed_action(crow::shed_action action, std::chrono::seconds retry_after = std::chrono::seconds(1))
+        {
+            admission_limits_.action = action;
+            admission_limits_.retry_after = retry_after;
+            return *this;
+        }
+
+        /// \brief Keep the memory of up to `max_free` closed connections per worker thread for new ones (256 by default, 0 to free it right away)
+        ///
+        /// Accepting a connection then doesn't go through the heap for the connection object.
+        /// The same number of 4 KiB read buffers (and as many bytes of larger ones) are kept for the worker's connections.
+        self_t& connection_pool_size(size_t max_free)
+        {
+            connection_pool_size_ = max_free;
+            return *this;
+        }
+
+        /// \brief Get how many closed connections per worker thread are kept for reuse
+        size_t connection_pool_size() const
+        {
+            return connection_pool_size_;
+        }
+
+        /// \brief Take the memory of connection objects from `allocator` instead of `operator new` when the pool has none to reuse
+        ///
+        /// Both functions are given the index of the worker thread the connection is for, and may be called from any thread.
+        self_t& connection_allocator(crow::connection_allocator allocator)
+        {
+            connection_allocator_ = std::move(allocator);
+            return *this;
+        }
+
+        /// \brief Get how many connections and requests were turned away for being over one of the limits (all zero if the server isn't running)
+        crow::shed_stats shed_stats() const
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_server_)
+                return ssl_server_->shed_stats();
+#endif
+            if (server_)
+                return server_->shed_stats();
+            if (unix_server_)
+                return unix_server_->shed_stats();
+            return {};
+        }
+
+        /// \brief Set the number of threads running the handlers of offloaded routes (see \ref RuleParameterTraits::offload())
+        ///
+        /// Defaults to the number of available threads. The pool is only started if a route is offloaded.
+        self_t& handler_threads(unsigned int threads)
+        {
+            handler_threads_ = threads;
+            return *this;
+        }
+
+        /// \brief Get the number of threads running the handlers of offloaded routes
+        unsigned int handler_threads() const
+        {
+            return handler_threads_ ? handler_threads_ : std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        /// \brief Get the queue depth, wait times and busy threads of the handler thread pool (all zero if it isn't running)
+        crow::handler_pool_stats handler_pool_stats() const
+        {
+            if (handler_pool_)
+                return handler_pool_->stats();
+            return {};
+        }
+
         /// \brief Set the server's log level
         ///
         /// Possible values are:
@@ -520,6 +830,52 @@ namespace crow
             return res_stream_threshold_;
         }
 
+        /// \brief Keep request headers as views into one buffer per connection instead of a map of strings (Default is false)
+        ///
+        /// Requests then reuse the memory of the previous request on their connection, parsing a typical request doesn't allocate.
+        /// `req.headers` is only filled when `req.get_headers()` or `req.get_header_value()` is called, `req.header()` reads a header without copying it.
+        self_t& request_views(bool enabled)
+        {
+            request_views_ = enabled;
+            return *this;
+        }
+
+        /// \brief Get whether request headers are kept as views
+        bool request_views() const
+        {
+            return request_views_;
+        }
+
+
+        /// \brief Cache the metadata and open descriptors of up to `max_entries` static files per worker thread (Default is 0, no caching)
+        ///
+        /// A cached file is looked at again at most `ttl` after it was last read from disk, so changes to the file take up to `ttl` to show.
+        /// Each worker sets up its cache when the server starts, so this has to be called before `run()`. Other threads (handler pool threads, or `handle_full()` calls) don't cache.
+        self_t& static_file_cache(size_t max_entries, std::chrono::milliseconds ttl = std::chrono::seconds(1))
+        {
+            static_file_cache_size_ = max_entries;
+            static_file_cache_ttl_ = ttl;
+            return *this;
+        }
+
+        /// \brief Serve precompressed siblings of static files (`file.br`, `file.zst`, `file.gz`) to clients accepting their encoding (Default is false)
+        self_t& precompressed_static_files(bool enabled)
+        {
+            precompressed_static_files_ = enabled;
+            return *this;
+        }
+
+        /// \brief Get whether precompressed siblings of static files are served
+        bool precompressed_static_files() const
+        {
+            return precompressed_static_files_;
+        }
+
+        /// \brief Get the hit, miss and eviction counts of the static file cache, counted over every app in the process
+        crow::static_file_cache_stats static_file_cache_stats() const
+        {
+            return detail::static_file_cache::stats();
+        }
 
         self_t& register_blueprint(Blueprint& blueprint)
         {
@@ -557,20 +913,95 @@ namespace crow
 
         self_t& use_compression(compression::algorithm algorithm)
         {
-            comp_algorithm_ = algorithm;
-            compression_used_ = true;
+            return use_compression(std::vector<compression::algorithm>{algorithm});
+        }
+
+        /// \brief Compress responses with any of the given algorithms, the client's Accept-Encoding decides which one is used
+        ///
+        /// When the client likes several algorithms equally, the one listed first is used.
+        self_t& use_compression(std::vector<compression::algorithm> algorithms)
+        {
+            comp_algorithms_.clear();
+            for (auto algorithm : algorithms)
+            {
+                if (compression::is_supported(algorithm))
+                    comp_algorithms_.push_back(algorithm);
+                else
+                    CROW_LOG_WARNING << "Compression with " << compression::encoding_name(algorithm) << " is not available in this build and won't be used.";
+            }
+            compression_used_ = !comp_algorithms_.empty();
             return *this;
         }
 
+        /// \brief Get the preferred compression algorithm
         compression::algorithm compression_algorithm()
         {
-            return comp_algorithm_;
+            return comp_algorithms_.empty() ? compression::DEFLATE : comp_algorithms_.front();
+        }
+
+        /// \brief Get the compression algorithms in order of preference
+        const std::vector<compression::algorithm>& compression_algorithms() const
+        {
+            return comp_algorithms_;
         }
 
         bool compression_used() const
         {
             return compression_used_;
         }
+
+        /// \brief Set the zlib compression level (for deflate and gzip), from 1 (fastest) to 9 (smallest) (Default is Z_DEFAULT_COMPRESSION)
+        self_t& compression_level(int level)
+        {
+            comp_levels_[compression::DEFLATE] = level;
+            comp_levels_[compression::GZIP] = level;
+            return *this;
+        }
+
+        /// \brief Set the compression level of one algorithm (brotli: 0 to 11, default 4; zstd: 1 to 22, default 3)
+        self_t& compression_level(compression::algorithm algorithm, int level)
+        {
+            comp_levels_[algorithm] = level;
+            return *this;
+        }
+
+        /// \brief Get the compression level of an algorithm
+        int compression_level(compression::algorithm algorithm)
+        {
+            auto level = comp_levels_.find(algorithm);
+            return level != comp_levels_.end() ? level->second : compression::default_level(algorithm);
+        }
+
+        int compression_level()
+        {
+            return compression_level(compression::GZIP);
+        }
+
+        /// \brief Set the zlib compression strategy, e.g. Z_FILTERED or Z_RLE (Default is Z_DEFAULT_STRATEGY)
+        self_t& compression_strategy(int strategy)
+        {
+            comp_strategy_ = strategy;
+            return *this;
+        }
+
+        int compression_strategy() const
+        {
+            return comp_strategy_;
+        }
+
+        /// \brief Set the response body size (in bytes) below which responses aren't compressed (Default is 0)
+        ///
+        /// Compressing small responses costs more CPU time than it saves in transfer time, and can even make them larger.
+        self_t& compression_threshold(size_t threshold)
+        {
+            comp_threshold_ = threshold;
+            return *this;
+        }
+
+        size_t compression_threshold() const
+        {
+            return comp_threshold_;
+        }
 #endif
 
         /// \brief Apply blueprints
@@ -626,6 +1057,12 @@ namespace crow
             add_static_dir();
 #endif
             validate();
+            draining_ = false;
+
+            if (router_.has_offloaded_handlers())
+                handler_pool_.reset(new detail::handler_pool(handler_threads()));
+
+            int listen_fd = inherited_listen_fd();
 
 #ifdef CROW_ENABLE_SSL
             if (ssl_used_)
@@ -639,8 +1076,17 @@ namespace crow
                 }
                 tcp::endpoint endpoint(addr, port_);
                 router_.using_ssl = true;
-                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_, tcp_socket_options_)));
+                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_, tcp_socket_options_, reuse_port_, listen_fd)));
                 ssl_server_->set_tick_function(tick_interval_, tick_function_);
+                ssl_server_->set_load_balancing(load_balancing_);
+                ssl_server_->set_cpu_affinity(worker_cpus_, acceptor_cpu_);
+                ssl_server_->set_admission_limits(admission_limits_);
+                ssl_server_->set_connection_pool(connection_pool_size_, connection_allocator_);
+                ssl_server_->set_static_file_cache(static_file_cache_size_, static_file_cache_ttl_);
+                if (drain_on_signal_)
+                    ssl_server_->set_signal_function([this] { drain(signal_drain_timeout_); });
+                if (!handoff_path_.empty())
+                    ssl_server_->set_socket_handoff(handoff_path_, [this] { drain(handoff_drain_timeout_); });
                 ssl_server_->signal_clear();
                 for (auto snum : signals_)
                 {
@@ -655,8 +1101,17 @@ namespace crow
                 if (use_unix_)
                 {
                     UnixSocketAcceptor::endpoint endpoint(bindaddr_);
-                    unix_server_ = std::move(std::unique_ptr<unix_server_t>(new unix_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                    unix_server_ = std::move(std::unique_ptr<unix_server_t>(new unix_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, {}, false, listen_fd)));
                     unix_server_->set_tick_function(tick_interval_, tick_function_);
+                    unix_server_->set_load_balancing(load_balancing_);
+                    unix_server_->set_cpu_affinity(worker_cpus_, acceptor_cpu_);
+                    unix_server_->set_admission_limits(admission_limits_);
+                    unix_server_->set_connection_pool(connection_pool_size_, connection_allocator_);
+                    unix_server_->set_static_file_cache(static_file_cache_size_, static_file_cache_ttl_);
+                    if (drain_on_signal_)
+                        unix_server_->set_signal_function([this] { drain(signal_drain_timeout_); });
+                    if (!handoff_path_.empty())
+                        unix_server_->set_socket_handoff(handoff_path_, [this] { drain(handoff_drain_timeout_); });
                     for (auto snum : signals_)
                     {
                         unix_server_->signal_add(snum);
@@ -673,8 +1128,17 @@ namespace crow
                         return;
                     }
                     TCPAcceptor::endpoint endpoint(addr, port_);
-                    server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, tcp_socket_options_)));
+                    server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, tcp_socket_options_, reuse_port_, listen_fd)));
                     server_->set_tick_function(tick_interval_, tick_function_);
+                    server_->set_load_balancing(load_balancing_);
+                    server_->set_cpu_affinity(worker_cpus_, acceptor_cpu_);
+                    server_->set_admission_limits(admission_limits_);
+                    server_->set_connection_pool(connection_pool_size_, connection_allocator_);
+                    server_->set_static_file_cache(static_file_cache_size_, static_file_cache_ttl_);
+                    if (drain_on_signal_)
+                        server_->set_signal_function([this] { drain(signal_drain_timeout_); });
+                    if (!handoff_path_.empty())
+                        server_->set_socket_handoff(handoff_path_, [this] { drain(handoff_drain_timeout_); });
                     for (auto snum : signals_)
                     {
                         server_->signal_add(snum);
@@ -683,6 +1147,7 @@ namespace crow
                     server_->run();
                 }
             }
+            handler_pool_.reset(); // Waits for the handlers still running
         }
 
         /// \brief Non-blocking version of \ref run()
@@ -699,6 +1164,7 @@ namespace crow
         /// \brief Stop the server
         void stop()
         {
+            close_sse_connections();
 #ifdef CROW_ENABLE_SSL
             if (ssl_used_)
             {
@@ -711,6 +1177,58 @@ namespace crow
                 if (server_) { server_->stop(); }
                 if (unix_server_) { unix_server_->stop(); }
             }
+            if (handler_pool_) { handler_pool_->stop(); }
+        }
+
+        /// \brief Stop the server once the open connections are done
+        ///
+        /// New connections are refused right away. Idle keep-alive connections are closed, the others are closed after their current response (which gets a `Connection: close` header).
+        /// Websockets and event streams are asked to close. The server stops once all connections are gone, or when `timeout` runs out.
+        /// Returns right away, \ref draining_connections() tells how many connections are left.
+        void drain(std::chrono::milliseconds timeout = std::chrono::seconds(30))
+        {
+            draining_ = true;
+            close_sse_connections();
+            close_websockets();
+
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            auto done = [this] {
+                return draining_connections() == 0;
+            };
+#ifdef CROW_ENABLE_SSL
+            if (ssl_server_) { ssl_server_->drain(deadline, done); }
+#endif
+            if (server_) { server_->drain(deadline, done); }
+            if (unix_server_) { unix_server_->drain(deadline, done); }
+        }
+
+        /// \brief Drain the server (see \ref drain()) instead of stopping it right away when a signal arrives, a second signal still stops it
+        self_t& drain_on_signal(std::chrono::milliseconds timeout = std::chrono::seconds(30))
+        {
+            drain_on_signal_ = true;
+            signal_drain_timeout_ = timeout;
+            return *this;
+        }
+
+        /// \brief Whether the server is draining, see \ref drain()
+        bool is_draining() const
+        {
+            return draining_;
+        }
+
+        /// \brief Get the number of connections (including websockets) the server is waiting for while draining, 0 if it isn't draining
+        size_t draining_connections()
+        {
+            if (!draining_)
+                return 0;
+            size_t count = 0;
+#ifdef CROW_ENABLE_SSL
+            if (ssl_server_) { count += ssl_server_->connection_count(); }
+#endif
+            if (server_) { count += server_->connection_count(); }
+            if (unix_server_) { count += unix_server_->connection_count(); }
+            std::lock_guard<std::mutex> lock{websockets_mutex_};
+            return count + websockets_.size();
         }
 
         void close_websockets()
@@ -736,6 +1254,30 @@ namespace crow
             websockets_.erase(std::remove(websockets_.begin(), websockets_.end(), conn), websockets_.end());
         }
 
+        void close_sse_connections()
+        {
+            std::vector<std::shared_ptr<sse::connection>> connections;
+            {
+                std::lock_guard<std::mutex> lock{sse_connections_mutex_};
+                connections = sse_connections_;
+            }
+            // Closing removes the connection from the list
+            for (auto& conn : connections)
+                conn->close();
+        }
+
+        void add_sse_connection(std::shared_ptr<sse::connection> conn)
+        {
+            std::lock_guard<std::mutex> lock{sse_connections_mutex_};
+            sse_connections_.push_back(conn);
+        }
+
+        void remove_sse_connection(std::shared_ptr<sse::connection> conn)
+        {
+            std::lock_guard<std::mutex> lock{sse_connections_mutex_};
+            sse_connections_.erase(std::remove(sse_connections_.begin(), sse_connections_.end(), conn), sse_connections_.end());
+        }
+
         /// \brief Print the routing paths defined for each HTTP method
         void debug_print()
         {
@@ -900,6 +1442,22 @@ namespace crow
             cv_started_.notify_all();
         }
 
+        /// \brief The already listening socket the server should use, -1 to bind its own
+        int inherited_listen_fd()
+        {
+            int fd = listen_fd_;
+            listen_fd_ = -1; // Owned (and closed when stopping) by the server from now on
+            if (fd < 0 && !handoff_path_.empty())
+            {
+                fd = detail::handoff::receive_fd(handoff_path_);
+                if (fd >= 0)
+                    CROW_LOG_INFO << "Took over the listening socket of the process serving " << handoff_path_;
+            }
+            if (fd < 0 && systemd_socket_activation_)
+                fd = detail::handoff::systemd_listen_fd();
+            return fd;
+        }
+
         void set_static_routes_added() {
             static_routes_added_ = true;
         }
@@ -912,7 +1470,21 @@ namespace crow
         std::uint8_t timeout_{5};
         uint16_t port_ = 80;
         unsigned int concurrency_ = 2;
+        bool reuse_port_ = false;
+        int listen_fd_ = -1;
+        bool systemd_socket_activation_ = false;
+        std::string handoff_path_;
+        std::chrono::milliseconds handoff_drain_timeout_{};
+        crow::load_balancing load_balancing_ = crow::load_balancing::least_connections;
+        detail::admission_limits admission_limits_;
+        size_t connection_pool_size_ = 256;
+        crow::connection_allocator connection_allocator_;
+        std::vector<int> worker_cpus_;
+        int acceptor_cpu_ = -1;
         std::atomic_bool is_bound_ = false;
+        std::atomic_bool draining_ = false;
+        bool drain_on_signal_ = false;
+        std::chrono::milliseconds signal_drain_timeout_{};
         uint64_t max_payload_{UINT64_MAX};
         std::string server_name_ = std::string("Crow/") + VERSION;
         std::string bindaddr_ = "0.0.0.0";
@@ -920,12 +1492,19 @@ namespace crow
         detail::socket::tcp_socket_options tcp_socket_options_{};
         detail::socket::tcp_socket_options websocket_tcp_socket_options_{};
         size_t res_stream_threshold_ = 1048576;
+        bool request_views_{false};
+        bool precompressed_static_files_{false};
+        size_t static_file_cache_size_{0};
+        std::chrono::milliseconds static_file_cache_ttl_{std::chrono::seconds(1)};
         Router router_;
         bool static_routes_added_{false};
 
 #ifdef CROW_ENABLE_COMPRESSION
-        compression::algorithm comp_algorithm_;
+        std::vector<compression::algorithm> comp_algorithms_;
         bool compression_used_{false};
+        std::unordered_map<int, int> comp_levels_;
+        int comp_strategy_{Z_DEFAULT_STRATEGY};
+        size_t comp_threshold_{0};
 #endif
 
         std::chrono::milliseconds tick_interval_;
@@ -941,6 +1520,8 @@ namespace crow
 
         std::unique_ptr<server_t> server_;
         std::unique_ptr<unix_server_t> unix_server_;
+        unsigned int handler_threads_ = 0;
+        std::unique_ptr<detail::handler_pool> handler_pool_; ///< After the servers, the tasks it drops may hold their connections.
 
         std::vector<int> signals_{SIGINT, SIGTERM};
 
@@ -949,6 +1530,8 @@ namespace crow
         std::mutex start_mutex_;
         std::mutex websockets_mutex_; ///< \brief mutex to protect websockets_
         std::vector<std::shared_ptr<websocket::connection>> websockets_;
+        std::mutex sse_connections_mutex_; ///< \brief mutex to protect sse_connections_
+        std::vector<std::shared_ptr<sse::connection>> sse_connections_; ///< \brief Open event streams, kept alive until they end
     };
 
     /// \brief Alias of Crow<Middlewares...>. Useful if you want
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <memory_resource>
 #include <string>
 #include <stdexcept>
 #include <iostream>
@@ -232,12 +233,31 @@ namespace crow
     };
 
     /// @cond SKIP
+    /// The values of a route's parameters.
+
+    ///
+    /// The vectors can draw from a connection's \ref detail::request_arena (copies go to the default memory resource).
     struct routing_params
     {
-        std::vector<int64_t> int_params;
-        std::vector<uint64_t> uint_params;
-        std::vector<double> double_params;
-        std::vector<std::string> string_params;
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+        std::pmr::vector<int64_t> int_params;
+        std::pmr::vector<uint64_t> uint_params;
+        std::pmr::vector<double> double_params;
+        std::pmr::vector<std::string> string_params;
+
+        routing_params() = default;
+
+        explicit routing_params(const allocator_type& alloc):
+          int_params(alloc), uint_params(alloc), double_params(alloc), string_params(alloc) {}
+
+        routing_params(const routing_params& other, const allocator_type& alloc):
+          int_params(other.int_params, alloc), uint_params(other.uint_params, alloc), double_params(other.double_params, alloc), string_params(other.string_params, alloc) {}
+
+        allocator_type get_allocator() const
+        {
+            return int_params.get_allocator();
+        }
 
         void debug_print() const
         {
@@ -287,24 +307,38 @@ namespace crow
 
     struct routing_handle_result
     {
+        using allocator_type = routing_params::allocator_type;
+
         bool catch_all{false};
         size_t rule_index;
-        std::vector<size_t> blueprint_indices;
+        std::pmr::vector<size_t> blueprint_indices;
         routing_params r_params;
         HTTPMethod method;
 
         routing_handle_result() {}
 
-        routing_handle_result(size_t rule_index_, std::vector<size_t> blueprint_indices_, routing_params r_params_):
+        /// An empty result whose vectors draw from `alloc`.
+        explicit routing_handle_result(const allocator_type& alloc):
+          rule_index(0),
+          blueprint_indices(alloc),
+          r_params(alloc),
+          method(HTTPMethod::InternalMethodCount) {}
+
+        routing_handle_result(size_t rule_index_, std::pmr::vector<size_t> blueprint_indices_, routing_params r_params_):
           rule_index(rule_index_),
-          blueprint_indices(blueprint_indices_),
-          r_params(r_params_) {}
+          blueprint_indices(std::move(blueprint_indices_)),
+          r_params(std::move(r_params_)) {}
 
-        routing_handle_result(size_t rule_index_, std::vector<size_t> blueprint_indices_, routing_params r_params_, HTTPMethod method_):
+        routing_handle_result(size_t rule_index_, std::pmr::vector<size_t> blueprint_indices_, routing_params r_params_, HTTPMethod method_):
           rule_index(rule_index_),
-          blueprint_indices(blueprint_indices_),
-          r_params(r_params_),
+          blueprint_indices(std::move(blueprint_indices_)),
+          r_params(std::move(r_params_)),
           method(method_) {}
+
+        allocator_type get_allocator() const
+        {
+            return r_params.get_allocator();
+        }
     };
 } // namespace crow
 
@@ -2,7 +2,16 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <zlib.h>
+#ifdef CROW_ENABLE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef CROW_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "crow/utility.h"
 
 // http://zlib.net/manual.html
 namespace crow // NOTE: Already documented in "crow/app.h"
@@ -17,42 +26,329 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             // windowBits can also be greater than 15 for optional gzip encoding.
             // Add 16 to windowBits to write a simple gzip header and trailer around the compressed data instead of a zlib wrapper.
             GZIP = 15 | 16,
+            // Not zlib based, outside of the windowBits range
+            BROTLI = 0x100, ///< Requires CROW_ENABLE_BROTLI (and linking libbrotlienc).
+            ZSTD = 0x200,   ///< Requires CROW_ENABLE_ZSTD (and linking libzstd).
         };
 
-        inline std::string compress_string(std::string const& str, algorithm algo)
+        /// Whether Crow was built with support for an algorithm.
+        inline bool is_supported(algorithm algo)
+        {
+            switch (algo)
+            {
+                case DEFLATE:
+                case GZIP:
+                    return true;
+#ifdef CROW_ENABLE_BROTLI
+                case BROTLI:
+                    return true;
+#endif
+#ifdef CROW_ENABLE_ZSTD
+                case ZSTD:
+                    return true;
+#endif
+                default:
+                    return false;
+            }
+        }
+
+        /// The name of an algorithm in the Accept-Encoding and Content-Encoding headers.
+        inline const char* encoding_name(algorithm algo)
+        {
+            switch (algo)
+            {
+                case DEFLATE: return "deflate";
+                case GZIP: return "gzip";
+                case BROTLI: return "br";
+                case ZSTD: return "zstd";
+            }
+            return "";
+        }
+
+        /// The level an algorithm uses unless told otherwise, chosen for compressing responses on the fly.
+        inline int default_level(algorithm algo)
         {
-            std::string compressed_str;
-            z_stream stream{};
-            // Initialize with the default values
-            if (::deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, algo, 8, Z_DEFAULT_STRATEGY) == Z_OK)
+            switch (algo)
             {
-                char buffer[8192];
+                case BROTLI: return 4; // Brotli's own default (11) is meant for compressing ahead of time
+                case ZSTD: return 3;
+                default: return Z_DEFAULT_COMPRESSION;
+            }
+        }
+
+        /// Pick the algorithm for a response from the request's Accept-Encoding header.
+
+        ///
+        /// The algorithm with the highest q-value wins, ties go to the one listed first in `preference`.
+        /// Returns false if the client accepts none of them.
+        inline bool negotiate(const std::string& accept_encoding, const std::vector<algorithm>& preference, algorithm& chosen)
+        {
+            float best_quality = 0;
+            for (algorithm algo : preference)
+            {
+                float quality = utility::header_token_quality(accept_encoding, encoding_name(algo));
+                if (quality > best_quality)
+                {
+                    best_quality = quality;
+                    chosen = algo;
+                }
+            }
+            return best_quality > 0;
+        }
+
+        /// Compressed data, kept as a list of fixed size chunks which can be handed to a socket without being copied again.
 
-                stream.avail_in = str.size();
+        ///
+        /// Chunks keep their memory when the buffer is cleared, so a buffer reused for many responses stops allocating.
+        struct chunked_buffer
+        {
+            static constexpr size_t chunk_size = 16384;
+            static constexpr size_t max_retained_chunks = 4; ///< Chunks kept by \ref clear(), to bound the memory of idle connections.
+
+            std::vector<std::string> chunks;
+            size_t used = 0; ///< Number of chunks holding data.
+            size_t size = 0; ///< Total number of bytes.
+
+            /// Get an empty chunk (of \ref chunk_size bytes) to write into.
+            std::string& next_chunk()
+            {
+                if (used == chunks.size())
+                    chunks.emplace_back();
+                auto& chunk = chunks[used++];
+                chunk.resize(chunk_size);
+                return chunk;
+            }
+
+            void clear()
+            {
+                used = 0;
+                size = 0;
+                if (chunks.size() > max_retained_chunks)
+                    chunks.resize(max_retained_chunks);
+            }
+
+            std::string to_string() const
+            {
+                std::string result;
+                result.reserve(size);
+                for (size_t i = 0; i < used; i++)
+                    result += chunks[i];
+                return result;
+            }
+        };
+
+        /// A deflate stream which is reset for every use instead of being set up from scratch.
+
+        ///
+        /// Setting up a zlib stream allocates a few hundred KiB, \ref local() keeps one stream per thread and algorithm around instead.
+        class compressor
+        {
+        public:
+            explicit compressor(algorithm algo):
+              algorithm_(algo)
+            {}
+
+            compressor(const compressor&) = delete;
+            compressor& operator=(const compressor&) = delete;
+
+            ~compressor()
+            {
+                if (initialized_)
+                    ::deflateEnd(&stream_);
+            }
+
+            /// The compressor of the calling thread for an algorithm.
+            static compressor& local(algorithm algo)
+            {
+                thread_local compressor deflate(DEFLATE), gzip(GZIP);
+                return algo == GZIP ? gzip : deflate;
+            }
+
+            /// Compress `size` bytes at `data` into `out`, using a zlib compression level and strategy.
+
+            ///
+            /// `out` is cleared first. Returns false (leaving `out` empty) if compression failed.
+            bool compress(const char* data, size_t size, chunked_buffer& out, int level = Z_DEFAULT_COMPRESSION, int strategy = Z_DEFAULT_STRATEGY)
+            {
+                out.clear();
+                if (!prepare(level, strategy))
+                    return false;
+
+                stream_.avail_in = static_cast<uInt>(size);
                 // zlib does not take a const pointer. The data is not altered.
-                stream.next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(str.c_str()));
+                stream_.next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(data));
 
                 int code = Z_OK;
+                while (code == Z_OK)
+                {
+                    auto& chunk = out.next_chunk();
+                    stream_.avail_out = static_cast<uInt>(chunk.size());
+                    stream_.next_out = reinterpret_cast<Bytef*>(&chunk[0]);
+
+                    code = ::deflate(&stream_, Z_FINISH);
+                    chunk.resize(chunk.size() - stream_.avail_out);
+                    out.size += chunk.size();
+                }
+
+                if (code != Z_STREAM_END)
+                {
+                    // The stream is in an unknown state, start over next time
+                    ::deflateEnd(&stream_);
+                    initialized_ = false;
+                    out.clear();
+                    return false;
+                }
+                return true;
+            }
+
+        private:
+            bool prepare(int level, int strategy)
+            {
+                if (initialized_ && level == level_ && strategy == strategy_)
+                    return ::deflateReset(&stream_) == Z_OK;
+
+                if (initialized_)
+                    ::deflateEnd(&stream_);
+                stream_ = z_stream{};
+                initialized_ = ::deflateInit2(&stream_, level, Z_DEFLATED, algorithm_, 8, strategy) == Z_OK;
+                level_ = level;
+                strategy_ = strategy;
+                return initialized_;
+            }
+
+            algorithm algorithm_;
+            z_stream stream_{};
+            bool initialized_ = false;
+            int level_ = Z_DEFAULT_COMPRESSION;
+            int strategy_ = Z_DEFAULT_STRATEGY;
+        };
+
+#ifdef CROW_ENABLE_BROTLI
+        /// Compress `size` bytes at `data` into `out` with brotli at quality `level` (0 to 11).
+
+        ///
+        /// Brotli has no way to reset an encoder, so every call sets one up.
+        inline bool brotli_compress(const char* data, size_t size, chunked_buffer& out, int level)
+        {
+            out.clear();
+            BrotliEncoderState* state = ::BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+            if (!state)
+                return false;
+            ::BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(level));
+            ::BrotliEncoderSetParameter(state, BROTLI_PARAM_SIZE_HINT, static_cast<uint32_t>(std::min<size_t>(size, 1u << 30)));
+
+            size_t available_in = size;
+            const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+            bool ok = true;
+            while (ok && !::BrotliEncoderIsFinished(state))
+            {
+                auto& chunk = out.next_chunk();
+                size_t available_out = chunk.size();
+                uint8_t* next_out = reinterpret_cast<uint8_t*>(&chunk[0]);
+
+                ok = ::BrotliEncoderCompressStream(state, BROTLI_OPERATION_FINISH, &available_in, &next_in, &available_out, &next_out, nullptr);
+                chunk.resize(chunk.size() - available_out);
+                out.size += chunk.size();
+            }
+            ::BrotliEncoderDestroyInstance(state);
+
+            if (!ok)
+                out.clear();
+            return ok;
+        }
+#endif
+
+#ifdef CROW_ENABLE_ZSTD
+        /// A zstd context which is reused (one per thread) for all responses, like \ref compressor.
+        class zstd_compressor
+        {
+        public:
+            zstd_compressor():
+              context_(::ZSTD_createCCtx())
+            {}
+
+            zstd_compressor(const zstd_compressor&) = delete;
+            zstd_compressor& operator=(const zstd_compressor&) = delete;
+
+            ~zstd_compressor()
+            {
+                ::ZSTD_freeCCtx(context_);
+            }
+
+            /// The compressor of the calling thread.
+            static zstd_compressor& local()
+            {
+                thread_local zstd_compressor compressor;
+                return compressor;
+            }
+
+            /// Compress `size` bytes at `data` into `out` at a zstd compression `level` (1 to 22).
+            bool compress(const char* data, size_t size, chunked_buffer& out, int level)
+            {
+                out.clear();
+                if (!context_ ||
+                    ::ZSTD_isError(::ZSTD_CCtx_reset(context_, ZSTD_reset_session_only)) ||
+                    ::ZSTD_isError(::ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level)) ||
+                    ::ZSTD_isError(::ZSTD_CCtx_setPledgedSrcSize(context_, size)))
+                    return false;
+
+                ZSTD_inBuffer input{data, size, 0};
+                size_t remaining;
                 do
                 {
-                    stream.avail_out = sizeof(buffer);
-                    stream.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+                    auto& chunk = out.next_chunk();
+                    ZSTD_outBuffer output{&chunk[0], chunk.size(), 0};
 
-                    code = ::deflate(&stream, Z_FINISH);
-                    // Successful and non-fatal error code returned by deflate when used with Z_FINISH flush
-                    if (code == Z_OK || code == Z_STREAM_END)
-                    {
-                        std::copy(&buffer[0], &buffer[sizeof(buffer) - stream.avail_out], std::back_inserter(compressed_str));
-                    }
+                    remaining = ::ZSTD_compressStream2(context_, &output, &input, ZSTD_e_end);
+                    chunk.resize(output.pos);
+                    out.size += output.pos;
+                } while (remaining != 0 && !::ZSTD_isError(remaining));
 
-                } while (code == Z_OK);
+                if (::ZSTD_isError(remaining))
+                {
+                    out.clear();
+                    return false;
+                }
+                return true;
+            }
 
-                if (code != Z_STREAM_END)
-                    compressed_str.clear();
+        private:
+            ZSTD_CCtx* context_;
+        };
+#endif
+
+        /// Compress `size` bytes at `data` into `out` with any supported algorithm.
 
-                ::deflateEnd(&stream);
+        ///
+        /// `level` means what the algorithm makes of it (zlib level, brotli quality or zstd level), `strategy` only applies to zlib.
+        inline bool compress(algorithm algo, const char* data, size_t size, chunked_buffer& out, int level, int strategy = Z_DEFAULT_STRATEGY)
+        {
+            switch (algo)
+            {
+                case DEFLATE:
+                case GZIP:
+                    return compressor::local(algo).compress(data, size, out, level, strategy);
+#ifdef CROW_ENABLE_BROTLI
+                case BROTLI:
+                    return brotli_compress(data, size, out, level);
+#endif
+#ifdef CROW_ENABLE_ZSTD
+                case ZSTD:
+                    return zstd_compressor::local().compress(data, size, out, level);
+#endif
+                default:
+                    out.clear();
+                    return false;
             }
+        }
 
+        inline std::string compress_string(std::string const& str, algorithm algo)
+        {
+            thread_local chunked_buffer buffer;
+            if (!compress(algo, str.data(), str.size(), buffer, default_level(algo)))
+                return {};
+            std::string compressed_str = buffer.to_string();
+            buffer.clear();
             return compressed_str;
         }
 
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    /// Where the memory of connection objects comes from when there's no freed one to reuse, see \ref Crow::connection_allocator().
+
+    ///
+    /// The memory has to be aligned like memory from `operator new`.
+    struct connection_allocator
+    {
+        std::function<void*(std::size_t size, unsigned int worker)> allocate;
+        std::function<void(void* block, std::size_t size, unsigned int worker)> deallocate;
+    };
+
+    namespace detail
+    {
+        /// Keeps the memory of a worker's closed connections for its next ones, instead of going through the heap for every connection.
+
+        ///
+        /// Blocks can be taken and given back from any thread.
+        class connection_pool
+        {
+        public:
+            connection_pool() = default;
+            connection_pool(const connection_pool&) = delete;
+            connection_pool& operator=(const connection_pool&) = delete;
+
+            ~connection_pool()
+            {
+                while (free_)
+                {
+                    auto block = free_;
+                    free_ = free_->next;
+                    release(block, block_size_);
+                }
+            }
+
+            /// Keep up to `max_free` blocks, get new ones from `allocator` (if set) on behalf of `worker`. Called before any block is taken.
+            void configure(size_t max_free, unsigned int worker, const connection_allocator* allocator)
+            {
+                max_free_ = max_free;
+                worker_ = worker;
+                allocator_ = allocator && allocator->allocate && allocator->deallocate ? allocator : nullptr;
+            }
+
+            void* allocate(std::size_t size)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (free_ && size == block_size_)
+                    {
+                        auto block = free_;
+                        free_ = free_->next;
+                        free_count_--;
+                        return block;
+                    }
+                }
+                return allocator_ ? allocator_->allocate(size, worker_) : ::operator new(size);
+            }
+
+            void deallocate(void* block, std::size_t size)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    // All blocks have the same size, that of the server's connections
+                    if (free_count_ < max_free_ && (block_size_ == 0 || size == block_size_) && size >= sizeof(free_block))
+                    {
+                        block_size_ = size;
+                        free_ = new (block) free_block{free_};
+                        free_count_++;
+                        return;
+                    }
+                }
+                release(block, size);
+            }
+
+        private:
+            struct free_block
+            {
+                free_block* next;
+            };
+
+            void release(void* block, std::size_t size)
+            {
+                if (allocator_)
+                    allocator_->deallocate(block, size, worker_);
+                else
+                    ::operator delete(block);
+            }
+
+        private:
+            std::mutex mutex_;
+            free_block* free_{nullptr};
+            size_t free_count_{0};
+            size_t block_size_{0};
+            size_t max_free_{0};
+            unsigned int worker_{0};
+            const connection_allocator* allocator_{nullptr};
+        };
+
+        /// Keeps the read buffers of a worker's connections, which only hold one while they are reading.
+
+        ///
+        /// Buffers come in a few size classes. A connection starts with the smallest one and gets larger ones for large headers and bodies.
+        /// Buffers can be taken and given back from any thread.
+        class read_buffer_pool
+        {
+        public:
+            static constexpr unsigned size_classes = 3;
+
+            /// 4 KiB, 16 KiB and 64 KiB.
+            static constexpr size_t class_size(unsigned size_class)
+            {
+                return size_t(4096) << (2 * size_class);
+            }
+
+            /// The smallest size class holding `size` bytes, or the largest one.
+            static unsigned class_for(uint64_t size)
+            {
+                unsigned size_class = 0;
+                while (size_class + 1 < size_classes && class_size(size_class) < size)
+                    size_class++;
+                return size_class;
+            }
+
+            read_buffer_pool() = default;
+            read_buffer_pool(const read_buffer_pool&) = delete;
+            read_buffer_pool& operator=(const read_buffer_pool&) = delete;
+
+            ~read_buffer_pool()
+            {
+                for (unsigned size_class = 0; size_class < size_classes; size_class++)
+                {
+                    while (free_[size_class])
+                    {
+                        auto block = free_[size_class];
+                        free_[size_class] = free_[size_class]->next;
+                        ::operator delete(block);
+                    }
+                }
+            }
+
+            /// Keep up to `max_free` buffers of the smallest class, and as many bytes in each larger class. Called before any buffer is taken.
+            void configure(size_t max_free)
+            {
+                max_free_ = max_free;
+            }
+
+            char* acquire(unsigned size_class)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (free_[size_class])
+                    {
+                        auto block = free_[size_class];
+                        free_[size_class] = free_[size_class]->next;
+                        free_count_[size_class]--;
+                        return reinterpret_cast<char*>(block);
+                    }
+                }
+                return static_cast<char*>(::operator new(class_size(size_class)));
+            }
+
+            void release(char* buffer, unsigned size_class)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (free_count_[size_class] < (max_free_ >> (2 * size_class)))
+                    {
+                        free_[size_class] = new (buffer) free_block{free_[size_class]};
+                        free_count_[size_class]++;
+                        return;
+                    }
+                }
+                ::operator delete(buffer);
+            }
+
+        private:
+            struct free_block
+            {
+                free_block* next;
+            };
+
+            std::mutex mutex_;
+            free_block* free_[size_classes]{};
+            size_t free_count_[size_classes]{};
+            size_t max_free_{0};
+        };
+
+        /// Allocator taking memory from a \ref connection_pool, for `std::allocate_shared()`.
+        template<typename T>
+        struct connection_pool_allocator
+        {
+            using value_type = T;
+
+            explicit connection_pool_allocator(connection_pool* source):
+              pool(source)
+            {}
+
+            template<typename U>
+            connection_pool_allocator(const connection_pool_allocator<U>& other):
+              pool(other.pool)
+            {}
+
+            T* allocate(std::size_t n)
+            {
+                static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "connection pool blocks have operator new's alignment");
+                return static_cast<T*>(pool->allocate(n * sizeof(T)));
+            }
+
+            void deallocate(T* p, std::size_t n)
+            {
+                pool->deallocate(p, n * sizeof(T));
+            }
+
+            template<typename U>
+            bool operator==(const connection_pool_allocator<U>& other) const
+            {
+                return pool == other.pool;
+            }
+
+            template<typename U>
+            bool operator!=(const connection_pool_allocator<U>& other) const
+            {
+                return pool != other.pool;
+            }
+
+            connection_pool* pool;
+        };
+    } // namespace detail
+} // namespace crow
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+
+#ifdef CROW_USE_BOOST
+#include <boost/asio.hpp>
+#else
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include <asio.hpp> // Brings in the Windows API headers in the right order
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "crow/logging.h"
+
+namespace crow
+{
+    namespace detail
+    {
+        namespace cpu
+        {
+            /// Whether threads can be pinned to CPUs on this platform.
+#if defined(_WIN32) || defined(__linux__)
+            constexpr bool supports_affinity = true;
+#else
+            constexpr bool supports_affinity = false;
+#endif
+
+            /// Restrict the calling thread to a single CPU, returns false (after logging why) if that didn't work.
+            inline bool pin_current_thread(int cpu)
+            {
+                if (cpu < 0)
+                    return false;
+#if defined(__linux__)
+                if (cpu >= CPU_SETSIZE)
+                {
+                    CROW_LOG_WARNING << "Can't pin a thread to CPU " << cpu << ", the highest supported CPU is " << CPU_SETSIZE - 1;
+                    return false;
+                }
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                if (result != 0)
+                {
+                    CROW_LOG_WARNING << "Failed to pin a thread to CPU " << cpu << ": error " << result;
+                    return false;
+                }
+                return true;
+#elif defined(_WIN32)
+                if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8) || !SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu))
+                {
+                    CROW_LOG_WARNING << "Failed to pin a thread to CPU " << cpu;
+                    return false;
+                }
+                return true;
+#else
+                CROW_LOG_WARNING << "Pinning threads to CPUs is not supported on this platform";
+                return false;
+#endif
+            }
+
+            /// The CPU and NUMA node the calling thread runs on, -1 where unknown.
+            inline void current_location(int& cpu, int& node)
+            {
+                cpu = -1;
+                node = -1;
+#if defined(__linux__) && defined(SYS_getcpu)
+                unsigned int c, n;
+                // The raw syscall also works with C libraries lacking a getcpu() wrapper
+                if (syscall(SYS_getcpu, &c, &n, nullptr) == 0)
+                {
+                    cpu = static_cast<int>(c);
+                    node = static_cast<int>(n);
+                }
+#elif defined(_WIN32)
+                cpu = static_cast<int>(GetCurrentProcessorNumber());
+#endif
+            }
+
+            /// E.g. "3 (node 1)", for logging.
+            inline std::string describe_location(int cpu, int node)
+            {
+                if (cpu < 0)
+                    return "?";
+                std::string text = std::to_string(cpu);
+                if (node >= 0)
+                    text += " (node " + std::to_string(node) + ')';
+                return text;
+            }
+        } // namespace cpu
+    } // namespace detail
+} // namespace crow
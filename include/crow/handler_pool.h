@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "crow/logging.h"
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    /// A snapshot of the handler thread pool, see \ref Crow::handler_threads().
+    struct handler_pool_stats
+    {
+        unsigned int threads{};                     ///< Threads in the pool.
+        unsigned int busy_threads{};                ///< Threads currently running a handler.
+        size_t queued{};                            ///< Handlers waiting for a free thread.
+        std::uint64_t completed{};                  ///< Handlers run since the server started.
+        std::chrono::microseconds wait_time{};      ///< Moving average of the time handlers waited in the queue.
+        std::chrono::microseconds max_wait_time{};  ///< Longest time a handler waited in the queue.
+    };
+
+    namespace detail
+    {
+        /// Runs route handlers that may block, away from the threads doing network IO.
+
+        ///
+        /// Every thread has its own queue, tasks are spread between them and a thread that runs out of work takes tasks from the others.
+        class handler_pool
+        {
+        public:
+            using task = std::function<void()>;
+
+            explicit handler_pool(unsigned int threads)
+            {
+                threads = std::max(threads, 1u);
+                for (unsigned int i = 0; i < threads; i++)
+                    queues_.emplace_back(new queue);
+                for (unsigned int i = 0; i < threads; i++)
+                    threads_.emplace_back([this, i] {
+                        run(i);
+                    });
+            }
+
+            handler_pool(const handler_pool&) = delete;
+            handler_pool& operator=(const handler_pool&) = delete;
+
+            ~handler_pool()
+            {
+                stop();
+                for (auto& thread : threads_)
+                {
+                    if (thread.joinable())
+                        thread.join();
+                }
+            }
+
+            /// Queue a task, can be called from any thread.
+            void post(task f)
+            {
+                auto& q = *queues_[next_++ % queues_.size()];
+                {
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    q.tasks.push_back({std::move(f), std::chrono::steady_clock::now()});
+                    queued_++;
+                }
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                wakeup_.notify_one();
+            }
+
+            /// Let the threads exit once they're done with their current task, tasks still queued are dropped.
+            void stop()
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stopping_ = true;
+                wakeup_.notify_all();
+            }
+
+            handler_pool_stats stats() const
+            {
+                handler_pool_stats stats;
+                stats.threads = static_cast<unsigned int>(threads_.size());
+                stats.busy_threads = busy_;
+                stats.queued = queued_;
+                stats.completed = completed_;
+                stats.wait_time = std::chrono::microseconds(wait_us_.load(std::memory_order_relaxed));
+                stats.max_wait_time = std::chrono::microseconds(max_wait_us_.load(std::memory_order_relaxed));
+                return stats;
+            }
+
+        private:
+            struct queued_task
+            {
+                task f;
+                std::chrono::steady_clock::time_point queued_at;
+            };
+
+            struct queue
+            {
+                std::mutex mutex;
+                std::deque<queued_task> tasks;
+            };
+
+            void run(size_t own)
+            {
+                queued_task t;
+                while (true)
+                {
+                    if (!take(own, t))
+                    {
+                        std::unique_lock<std::mutex> lock(sleep_mutex_);
+                        wakeup_.wait(lock, [this] {
+                            return stopping_ || queued_ > 0;
+                        });
+                        if (stopping_)
+                            return;
+                        continue;
+                    }
+                    if (stopping_)
+                        return;
+
+                    record_wait(std::chrono::steady_clock::now() - t.queued_at);
+                    busy_++;
+                    try
+                    {
+                        t.f();
+                    }
+                    catch (std::exception& e)
+                    {
+                        CROW_LOG_ERROR << "Handler pool: an uncaught exception occurred: " << e.what();
+                    }
+                    busy_--;
+                    completed_++;
+                    t.f = nullptr; // Release what the task holds before waiting for the next one
+                }
+            }
+
+            /// Take the oldest task of the thread's own queue, or steal the newest one of another thread's queue.
+            bool take(size_t own, queued_task& t)
+            {
+                for (size_t n = 0; n < queues_.size(); n++)
+                {
+                    auto& q = *queues_[(own + n) % queues_.size()];
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    if (q.tasks.empty())
+                        continue;
+                    if (n == 0)
+                    {
+                        t = std::move(q.tasks.front());
+                        q.tasks.pop_front();
+                    }
+                    else
+                    {
+                        t = std::move(q.tasks.back());
+                        q.tasks.pop_back();
+                    }
+                    queued_--;
+                    return true;
+                }
+                return false;
+            }
+
+            void record_wait(std::chrono::steady_clock::duration wait)
+            {
+                auto sample = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+                // Racing updates from other threads only lose a sample
+                auto average = wait_us_.load(std::memory_order_relaxed);
+                average = average == 0 ? sample : (average * 7 + sample) / 8;
+                wait_us_.store(average, std::memory_order_relaxed);
+                if (sample > max_wait_us_.load(std::memory_order_relaxed))
+                    max_wait_us_.store(sample, std::memory_order_relaxed);
+            }
+
+        private:
+            std::vector<std::unique_ptr<queue>> queues_;
+            std::vector<std::thread> threads_;
+            std::atomic<size_t> next_{0};
+
+            std::mutex sleep_mutex_;
+            std::condition_variable wakeup_;
+            std::atomic<size_t> queued_{0};
+            std::atomic<bool> stopping_{false};
+
+            std::atomic<unsigned int> busy_{0};
+            std::atomic<std::uint64_t> completed_{0};
+            std::atomic<std::uint64_t> wait_us_{0};
+            std::atomic<std::uint64_t> max_wait_us_{0};
+        };
+    } // namespace detail
+} // namespace crow
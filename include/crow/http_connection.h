@@ -12,17 +12,24 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "crow/http_parser_merged.h"
+#include "crow/admission_control.h"
 #include "crow/common.h"
 #include "crow/compression.h"
 #include "crow/http_response.h"
+#include "crow/load_balancing.h"
 #include "crow/logging.h"
 #include "crow/middleware.h"
 #include "crow/middleware_context.h"
 #include "crow/parser.h"
+#include "crow/request_arena.h"
 #include "crow/settings.h"
 #include "crow/socket_adaptors.h"
 #include "crow/task_timer.h"
@@ -42,9 +49,83 @@ namespace crow
     static std::atomic<int> connectionCount;
 #endif
 
+    namespace detail
+    {
+        /// The connections of a worker thread, so they can all be reached at once (e.g. to drain them).
+
+        ///
+        /// The connection type is left out, so that a server type can be named without instantiating its connections.
+        struct connection_list
+        {
+            /// The links of a connection in the list (a base of the connection, so that joining the list doesn't allocate).
+            struct hook
+            {
+                hook* prev{nullptr};
+                hook* next{nullptr};
+            };
+
+            connection_list()
+            {
+                head.prev = head.next = &head;
+            }
+
+            void insert(hook& connection)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                connection.prev = head.prev;
+                connection.next = &head;
+                head.prev->next = &connection;
+                head.prev = &connection;
+                size++;
+            }
+
+            void erase(hook& connection)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                connection.prev->next = connection.next;
+                connection.next->prev = connection.prev;
+                size--;
+            }
+
+            /// Call `f` with every connection that is still alive, without holding the lock.
+            template<typename Connection, typename F>
+            void for_each(F f)
+            {
+                std::vector<std::shared_ptr<Connection>> alive;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    alive.reserve(size);
+                    for (hook* connection = head.next; connection != &head; connection = connection->next)
+                        if (auto p = static_cast<Connection*>(connection)->weak_from_this().lock()) // Empty while being created or destroyed
+                            alive.push_back(std::move(p));
+                }
+                for (auto& p : alive)
+                    f(*p);
+            }
+
+        private:
+            std::mutex mutex;
+            hook head; ///< Before the first connection and after the last one.
+            size_t size{0};
+        };
+
+        /// Buffers kept in a vector elsewhere, as a buffer sequence that asio copies into a write operation without copying the vector.
+        struct buffer_range
+        {
+            const asio::const_buffer* first;
+            const asio::const_buffer* last;
+
+            explicit buffer_range(const std::vector<asio::const_buffer>& buffers):
+              first(buffers.data()), last(buffers.data() + buffers.size()) {}
+
+            const asio::const_buffer* begin() const { return first; }
+            const asio::const_buffer* end() const { return last; }
+        };
+    } // namespace detail
+
     /// An HTTP connection.
     template<typename Adaptor, typename Handler, typename... Middlewares>
-    class Connection : public std::enable_shared_from_this<Connection<Adaptor, Handler, Middlewares...>>
+    class Connection : public std::enable_shared_from_this<Connection<Adaptor, Handler, Middlewares...>>, public detail::connection_list::hook
     {
         friend struct crow::response;
 
@@ -52,24 +133,32 @@ namespace crow
         Connection(
           asio::io_context& io_context,
           Handler* handler,
-          const std::string& server_name,
+          const std::string& server_header,
           std::tuple<Middlewares...>* middlewares,
-          std::function<std::string()>& get_cached_date_str_f,
+          detail::date_header& date_header,
           detail::task_timer& task_timer,
+          detail::read_buffer_pool& read_buffers,
           typename Adaptor::context* adaptor_ctx_,
-          std::atomic<unsigned int>& queue_length):
+          detail::worker_load_counters& load,
+          detail::connection_list& connections,
+          detail::admission_control& admission):
           adaptor_(io_context, adaptor_ctx_),
           handler_(handler),
           parser_(this),
           req_(parser_.req),
-          server_name_(server_name),
+          server_header_(server_header),
           middlewares_(middlewares),
-          get_cached_date_str(get_cached_date_str_f),
+          date_header_(date_header),
           task_timer_(task_timer),
+          read_buffers_(read_buffers),
           res_stream_threshold_(handler->stream_threshold()),
-          queue_length_(queue_length)
+          load_(load),
+          connections_(connections),
+          admission_(admission)
         {
-            queue_length_++;
+            parser_.request_views = handler->request_views();
+            load_.connections++;
+            connections_.insert(*this);
 #ifdef CROW_ENABLE_DEBUG
             connectionCount++;
             CROW_LOG_DEBUG << "Connection (" << this << ") allocated, total: " << connectionCount;
@@ -78,7 +167,14 @@ namespace crow
 
         ~Connection()
         {
-            queue_length_--;
+            release_read_buffer();
+            close_static_file_fd();
+            if (request_pending_)
+                load_.request_finished({}, false);
+            connections_.erase(*this);
+            load_.connections--;
+            if (admitted_)
+                admission_.connection_closed(peer_is_ip_ ? &peer_address_ : nullptr);
 #ifdef CROW_ENABLE_DEBUG
             connectionCount--;
             CROW_LOG_DEBUG << "Connection (" << this << ") freed, total: " << connectionCount;
@@ -99,7 +195,15 @@ namespace crow
                 {
                     self->start_deadline();
                     self->parser_.clear();
+                    if constexpr (!Adaptor::encrypted)
+                    {
+                        // Data is read right away once the socket is readable, see do_read()
+                        error_code ignored;
+                        self->adaptor_.raw_socket().non_blocking(true, ignored);
+                    }
 
+                    // Not idle yet: the client is about to send its first request, which is answered even if the server is draining by now
+                    self->next_read_starts_request_ = true;
                     self->do_read();
                 }
                 else
@@ -111,9 +215,12 @@ namespace crow
 
         void handle_url()
         {
-            routing_handle_result_ = handler_->handle_initial(req_, res);
+            // The previous request's route is dropped along with the rest of the arena's memory
+            routing_handle_result_ = routing_handle_result(routing_handle_result_.get_allocator());
+            arena_.reset();
+            handler_->handle_initial(req_, res, routing_handle_result_);
             // if no route is found for the request method, return the response without parsing or processing anything further.
-            if (!routing_handle_result_->rule_index && !routing_handle_result_->catch_all && (req_.method != HTTPMethod::Options || routing_handle_result_->method == HTTPMethod::InternalMethodCount))
+            if (!routing_handle_result_.rule_index && !routing_handle_result_.catch_all && (req_.method != HTTPMethod::Options || routing_handle_result_.method == HTTPMethod::InternalMethodCount))
             {
                 parser_.done();
                 need_to_call_after_handlers_ = true;
@@ -124,28 +231,58 @@ namespace crow
         void handle_header()
         {
             // HTTP 1.1 Expect: 100-continue
-            if (req_.http_ver_major == 1 && req_.http_ver_minor == 1 && get_header_value(req_.headers, "expect") == "100-continue")
+            if (req_.http_ver_major == 1 && req_.http_ver_minor == 1 && req_.header("expect") == "100-continue")
             {
-                continue_requested = true;
-                buffers_.clear();
                 static const std::string expect_100_continue = "HTTP/1.1 100 Continue\r\n\r\n";
-                buffers_.emplace_back(expect_100_continue.data(), expect_100_continue.size());
-                error_code ec = do_write_sync(buffers_);
-                if (ec)
-                {
-                    CROW_LOG_ERROR << ec << " buffer write error happened while handling sending continuation buffer header";
-                }
+                queue_write({asio::buffer(expect_100_continue)}, [](const error_code& ec) {
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << ec << " buffer write error happened while handling sending continuation buffer header";
+                    }
+                });
             }
-            if (!routing_handle_result_->rule_index && !routing_handle_result_->catch_all && req_.method == HTTPMethod::Options)
+            if (!routing_handle_result_.rule_index && !routing_handle_result_.catch_all && req_.method == HTTPMethod::Options)
             {
                 parser_.done();
                 need_to_call_after_handlers_ = true;
                 complete_request();
             }
+            else if (handler_->streams_body(routing_handle_result_))
+            {
+                // The handler runs right away and receives the body while it arrives
+                auto self = this->shared_from_this();
+                body_stream_ = std::make_shared<request_body_stream>();
+                body_stream_->resume_handler_ = [self, stream = std::weak_ptr<request_body_stream>(body_stream_)] {
+                    asio::dispatch(self->adaptor_.get_io_context(), [self, stream] {
+                        self->resume_body(stream.lock());
+                    });
+                };
+                req_.body_stream = body_stream_;
+                parser_.stream_body = true;
+                handle();
+            }
+        }
+
+        /// Pass part of a streamed request body on, returns false if the receiver wants a break.
+        bool handle_body(const char* data, size_t size)
+        {
+            if (body_stream_->handler_)
+                body_stream_->handler_(std::string_view(data, size), false);
+            return !body_stream_->paused_;
         }
 
         void handle()
         {
+            if (body_stream_ && parser_.message_done())
+            {
+                // The request was handled when its headers arrived, only the end of the body is left to report
+                cancel_deadline_timer();
+                body_stream_->complete_ = true;
+                if (body_stream_->handler_)
+                    body_stream_->handler_({}, true);
+                return;
+            }
+
             // TODO(EDev): cancel_deadline_timer should be looked into, it might be a good idea to add it to handle_url() and then restart the timer once everything passes
             cancel_deadline_timer();
             bool is_invalid_request = false;
@@ -156,13 +293,16 @@ namespace crow
             req_.middleware_context = static_cast<void*>(&ctx_);
             req_.middleware_container = static_cast<void*>(middlewares_);
             req_.io_context = &adaptor_.get_io_context();
-            req_.remote_ip_address = adaptor_.address();
+            req_.task_timer = &task_timer_;
+            if (remote_ip_address_.empty())
+                remote_ip_address_ = adaptor_.address();
+            req_.remote_ip_address = remote_ip_address_;
             add_keep_alive_ = req_.keep_alive;
             close_connection_ = req_.close_connection;
 
             if (req_.check_version(1, 1)) // HTTP/1.1
             {
-                if (!req_.headers.count("host"))
+                if (!req_.header_count("host"))
                 {
                     is_invalid_request = true;
                     res = response(400);
@@ -170,7 +310,7 @@ namespace crow
                 else if (req_.upgrade && req_.method != HTTPMethod::Options)
                 {
                     // h2 or h2c headers
-                    if (req_.get_header_value("upgrade").find("h2")==0)
+                    if (req_.header("upgrade").find("h2")==0)
                     {
                         // TODO(ipkn): HTTP/2
                         // currently, ignore upgrade header
@@ -195,22 +335,41 @@ namespace crow
             {
                 res.complete_request_handler_ = nullptr;
                 auto self = this->shared_from_this();
-                res.is_alive_helper_ = [self]() -> bool {
-                    return self->adaptor_.is_open();
+                // The response belongs to the connection, it can't be asked about it once the connection is gone
+                res.is_alive_helper_ = [this]() -> bool {
+                    return adaptor_.is_open();
                 };
 
+                request_pending_ = true;
+                request_start_ = std::chrono::steady_clock::now();
+                load_.request_started();
+
                 detail::middleware_call_helper<detail::middleware_call_criteria_only_global,
                                                0, decltype(ctx_), decltype(*middlewares_)>({}, *middlewares_, req_, res, ctx_);
 
-                if (!res.completed_)
+                if (!res.completed_ && handler_->offloads_handler(routing_handle_result_))
                 {
+                    // The handler may block, it runs on the handler pool and the response is sent from this connection's thread
                     res.complete_request_handler_ = [self] {
-                        self->complete_request();
+                        asio::post(self->adaptor_.get_io_context(), [self] {
+                            self->complete_request();
+                        });
+                    };
+                    need_to_call_after_handlers_ = true;
+                    handler_->offload([self] {
+                        self->handler_->handle(self->req_, self->res, self->routing_handle_result_);
+                    });
+                }
+                else if (!res.completed_)
+                {
+                    // The connection holds on to itself until the response is complete (a lambda holding the pointer wouldn't fit in the std::function)
+                    self_until_complete_ = std::move(self);
+                    res.complete_request_handler_ = [this] {
+                        auto keep_alive = std::move(self_until_complete_);
+                        complete_request();
                     };
                     need_to_call_after_handlers_ = true;
                     handler_->handle(req_, res, routing_handle_result_);
-                    if (add_keep_alive_)
-                        res.set_header("connection", "Keep-Alive");
                 }
                 else
                 {
@@ -223,11 +382,55 @@ namespace crow
             }
         }
 
+        /// Close the connection if it's waiting for the next request, a request in progress gets the connection's last response.
+
+        ///
+        /// Called on the connection's thread when the server is draining.
+        void drain()
+        {
+            if (waiting_for_request_ && adaptor_.is_open())
+            {
+                cancel_deadline_timer();
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+            }
+        }
+
+        /// Record that the server counted this connection in (see \ref detail::admission_control::admit_connection()), so that it's counted out when it closes.
+        void admitted(const asio::ip::address* address)
+        {
+            admitted_ = true;
+            if (address)
+            {
+                peer_address_ = *address;
+                peer_is_ip_ = true;
+            }
+        }
+
         /// Call the after handle middleware and send the write the response to the connection.
         void complete_request()
         {
+            // The response's completion handler may hold the last reference to the connection, and it's cleared on the way
+            auto self = this->shared_from_this();
+            if (body_stream_ && !body_stream_->complete_)
+            {
+                // Answered before the whole body arrived, the rest of it can't be told apart from the next request
+                close_connection_ = true;
+            }
+            if (handler_->is_draining())
+            {
+                // The server is shutting down, this is the last response on this connection
+                close_connection_ = true;
+                add_keep_alive_ = false;
+                res.set_header("Connection", "close");
+            }
             CROW_LOG_INFO << "Response: " << this << ' ' << req_.raw_url << ' ' << res.code << ' ' << close_connection_;
             res.is_alive_helper_ = nullptr;
+            if (request_pending_)
+            {
+                request_pending_ = false;
+                load_.request_finished(std::chrono::steady_clock::now() - request_start_);
+            }
 
             if (need_to_call_after_handlers_)
             {
@@ -241,37 +444,45 @@ namespace crow
                   decltype(*middlewares_)>({}, *middlewares_, ctx_, req_, res);
             }
 #ifdef CROW_ENABLE_COMPRESSION
-            if (!res.body.empty() && handler_->compression_used())
+            if (res.compressed && !res.body.empty() && res.body.size() >= handler_->compression_threshold() &&
+                handler_->compression_used() && !res.headers.count("Content-Encoding"))
+            {
+                compression::algorithm algorithm;
+                if (compression::negotiate(req_.get_header_value("Accept-Encoding"), handler_->compression_algorithms(), algorithm))
+                    compress_body(algorithm);
+            }
+#endif
+
+            if (res.is_streaming())
             {
-                std::string accept_encoding = req_.get_header_value("Accept-Encoding");
-                if (!accept_encoding.empty() && res.compressed)
+                // The body length isn't known up front
+                res.headers.erase("Content-Length");
+                res.manual_length_header = true;
+                if (req_.check_version(1, 1))
                 {
-                    switch (handler_->compression_algorithm())
-                    {
-                        case compression::DEFLATE:
-                            if (accept_encoding.find("deflate") != std::string::npos)
-                            {
-                                res.body = compression::compress_string(res.body, compression::algorithm::DEFLATE);
-                                res.set_header("Content-Encoding", "deflate");
-                            }
-                            break;
-                        case compression::GZIP:
-                            if (accept_encoding.find("gzip") != std::string::npos)
-                            {
-                                res.body = compression::compress_string(res.body, compression::algorithm::GZIP);
-                                res.set_header("Content-Encoding", "gzip");
-                            }
-                            break;
-                        default:
-                            break;
-                    }
+                    res.set_header("Transfer-Encoding", "chunked");
+                }
+                else
+                {
+                    // HTTP/1.0 has no chunked encoding, the end of the connection marks the end of the body
+                    add_keep_alive_ = false;
+                    close_connection_ = true;
                 }
             }
-#endif
+            else if (res.is_static_type())
+            {
+                if (handler_->precompressed_static_files())
+                    res.select_precompressed_static_file(req_);
+                res.evaluate_static_file_request(req_);
+            }
 
             prepare_buffers();
 
-            if (res.is_static_type())
+            if (res.is_streaming())
+            {
+                start_stream();
+            }
+            else if (res.is_static_type())
             {
                 do_write_static();
             }
@@ -282,6 +493,20 @@ namespace crow
         }
 
     private:
+#ifdef CROW_ENABLE_COMPRESSION
+        /// Compress the response body into `compressed_body_`, which is sent in its place.
+        void compress_body(compression::algorithm algorithm)
+        {
+            if (compression::compress(algorithm, res.body.data(), res.body.size(), compressed_body_,
+                                      handler_->compression_level(algorithm), handler_->compression_strategy()))
+            {
+                res.set_header("Content-Length", std::to_string(compressed_body_.size));
+                res.set_header("Content-Encoding", compression::encoding_name(algorithm));
+                res.add_vary_header("Accept-Encoding");
+            }
+        }
+#endif
+
         void prepare_buffers()
         {
             res.complete_request_handler_ = nullptr;
@@ -293,199 +518,749 @@ namespace crow
                 //delete this;
                 return;
             }
-            res.write_header_into_buffer(buffers_, content_length_, add_keep_alive_, server_name_);
+            date_line_ = date_header_.line();
+            res.write_header_into_buffer(buffers_, header_block_, add_keep_alive_, server_header_, date_line_.get());
         }
 
         void do_write_static()
         {
-            asio::write(adaptor_.socket(), buffers_);
+            if (res.file_info.ranges.empty())
+                res.file_info.ranges.push_back({0, static_cast<uint64_t>(res.file_info.statbuf.st_size), {}});
 
-            if (res.file_info.statResult == 0)
+            if (res.skip_body || res.file_info.statResult != 0)
             {
-                std::ifstream is(res.file_info.path.c_str(), std::ios::in | std::ios::binary);
-                std::vector<asio::const_buffer> buffers{1};
-                char buf[16384];
-                is.read(buf, sizeof(buf));
-                while (is.gcount() > 0)
+                // HEAD request, only the headers are sent
+                queue_write(std::move(buffers_), [this](const error_code& ec) {
+                    finish_response(ec);
+                });
+                return;
+            }
+
+            if constexpr (Adaptor::supports_sendfile)
+            {
+                if (open_static_file_fd())
                 {
-                    buffers[0] = asio::buffer(buf, is.gcount());
-                    error_code ec = do_write_sync(buffers);
-                    if (ec) {
-                        CROW_LOG_ERROR << ec << " - buffer write error happened while sending content of file "
-                                       << res.file_info.path << ". Writing stopped premature.";
-                        break;
+                    // Zero-copy: the file goes from the page cache straight to the socket
+                    auto on_part_written = [this](const error_code& ec) {
+                        if (ec)
+                            adaptor_.shutdown_readwrite(); // Make the rest of the transfer fail as well
+                    };
+                    queue_write(std::move(buffers_), on_part_written);
+                    for (auto& range : res.file_info.ranges)
+                    {
+                        if (!range.part_header.empty())
+                            queue_write({asio::buffer(range.part_header)}, on_part_written);
+                        queue_sendfile(static_file_handle_->fd(), range.offset, range.length, on_part_written);
+                    }
+                    queue_write({asio::buffer(res.file_info.ranges_trailer)}, [this](const error_code& ec) {
+                        if (ec)
+                        {
+                            CROW_LOG_ERROR << ec << " - sendfile error happened while sending content of file "
+                                           << res.file_info.path << ". Writing stopped premature.";
+                        }
+                        close_static_file_fd();
+                        finish_response(ec);
+                    });
+                    return;
+                }
+            }
+
+            static_file_.open(res.file_info.path.c_str(), std::ios::in | std::ios::binary);
+            static_file_range_ = 0;
+            static_file_remaining_ = 0;
+            queue_write(std::move(buffers_), [this](const error_code& ec) {
+                do_write_static_chunk(ec);
+            });
+        }
+
+        /// Send the next part of the static file once the previous write has completed.
+        void do_write_static_chunk(const error_code& ec)
+        {
+            auto& ranges = res.file_info.ranges;
+            if (!ec && static_file_.is_open())
+            {
+                if (static_file_remaining_ == 0 && static_file_range_ < ranges.size())
+                {
+                    auto& range = ranges[static_file_range_++];
+                    static_file_.seekg(static_cast<std::streamoff>(range.offset));
+                    static_file_remaining_ = range.length;
+                    if (!range.part_header.empty())
+                    {
+                        queue_write({asio::buffer(range.part_header)}, [this](const error_code& write_ec) {
+                            do_write_static_chunk(write_ec);
+                        });
+                        return;
+                    }
+                }
+
+                if (static_file_remaining_ > 0)
+                {
+                    static_file_buffer_.resize(16384);
+                    static_file_.read(&static_file_buffer_[0], static_cast<std::streamsize>(std::min<uint64_t>(static_file_buffer_.size(), static_file_remaining_)));
+                    if (static_file_.gcount() > 0)
+                    {
+                        static_file_remaining_ -= static_cast<uint64_t>(static_file_.gcount());
+                        queue_write({asio::buffer(static_file_buffer_.data(), static_file_.gcount())}, [this](const error_code& write_ec) {
+                            do_write_static_chunk(write_ec);
+                        });
+                        return;
+                    }
+                    // The file got shorter than announced, the client can only tell if the connection ends
+                    close_connection_ = true;
+                }
+                else if (!res.file_info.ranges_trailer.empty())
+                {
+                    queue_write({asio::buffer(res.file_info.ranges_trailer)}, [this](const error_code& write_ec) {
+                        res.file_info.ranges_trailer.clear();
+                        do_write_static_chunk(write_ec);
+                    });
+                    return;
+                }
+            }
+            else if (ec)
+            {
+                CROW_LOG_ERROR << ec << " - buffer write error happened while sending content of file "
+                               << res.file_info.path << ". Writing stopped premature.";
+            }
+
+            static_file_.close();
+            static_file_.clear();
+            finish_response(ec);
+        }
+
+        void do_write_general()
+        {
+#ifdef CROW_ENABLE_COMPRESSION
+            if (compressed_body_.used)
+            {
+                // The compressed chunks are written as they are, the (uncompressed) body isn't needed anymore
+                for (size_t i = 0; i < compressed_body_.used; i++)
+                    buffers_.emplace_back(asio::buffer(compressed_body_.chunks[i]));
+                queue_write(std::move(buffers_), [this](const error_code& ec) {
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << ec << " - buffer write error happened while sending compressed response. Writing stopped premature.";
+                    }
+                    finish_response(ec);
+                });
+                return;
+            }
+#endif
+            res_body_copy_.swap(res.body);
+            if (res_body_copy_.length() < res_stream_threshold_ && feeding_ && !close_connection_ && adaptor_.is_open())
+            {
+                // Answered while the read buffer is being parsed, more pipelined requests may follow in it
+                queue_pipelined_response();
+            }
+            else if (res_body_copy_.length() < res_stream_threshold_)
+            {
+                buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
+                queue_write(std::move(buffers_), [this](const error_code& ec) {
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << ec << " - buffer write error happened while sending response. Writing stopped premature.";
+                    }
+                    finish_response(ec);
+                });
+            }
+            else
+            {
+                // Write the response start / headers, then the body in slices
+                queue_write(std::move(buffers_), [this](const error_code& ec) {
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << ec << "- buffer write error happened while sending response start / headers. Writing stopped premature.";
+                        finish_response(ec);
+                        return;
+                    }
+                    do_write_body_slice(0);
+                });
+            }
+        }
+
+        /// Queue the response with its own copy of the headers and body, so that the next request can be handled before it's written.
+
+        ///
+        /// The responses queued one after the other share a buffer, which is written once the parser is done with the read buffer.
+        void queue_pipelined_response()
+        {
+            // A job already being written can't take more data
+            if (write_queue_.empty() || !write_queue_.back().coalesce || !write_queue_.back().body.empty() ||
+                (is_writing_ && write_queue_.size() <= jobs_in_flight_))
+            {
+                write_queue_.emplace_back(std::vector<asio::const_buffer>{}, [this](const error_code& ec) {
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << ec << " - buffer write error happened while sending response. Writing stopped premature.";
+                        adaptor_.shutdown_readwrite();
+                        adaptor_.close();
                     }
-                    is.read(buf, sizeof(buf));
+                });
+                write_queue_.back().coalesce = true;
+                write_queue_.back().payload.swap(spare_pipelined_buffer_);
+                write_queue_.back().buffers.swap(spare_pipelined_buffers_);
+            }
+
+            // The job owns the data, it stays in place (a deque doesn't move its elements) until it's written
+            auto& job = write_queue_.back();
+            job.payload += header_block_;
+            if (buffers_.size() > 1)
+                job.payload += *date_line_; // The headers end with the date line
+            if (res_body_copy_.size() <= pipelined_body_copy_limit)
+                job.payload += res_body_copy_;
+            else
+                job.body.swap(res_body_copy_);
+            job.buffers.clear();
+            job.buffers.emplace_back(asio::buffer(job.payload));
+            if (!job.body.empty())
+                job.buffers.emplace_back(asio::buffer(job.body));
+            buffers_.clear();
+            response_pipelined_ = true;
+        }
+
+        /// Send the part of a streamed response body starting at `transferred`.
+        void do_write_body_slice(size_t transferred)
+        {
+            size_t length = res_body_copy_.length();
+            if (transferred >= length)
+            {
+                finish_response(error_code());
+                return;
+            }
+
+            size_t to_transfer = CROW_MIN(16384UL, length - transferred);
+            queue_write({asio::const_buffer(res_body_copy_.data() + transferred, to_transfer)}, [this, transferred, to_transfer](const error_code& ec) {
+                if (ec)
+                {
+                    CROW_LOG_ERROR << ec << " - " << transferred << " - buffer write error happened while sending response. Writing stopped premature.";
+                    finish_response(ec);
+                    return;
                 }
+                do_write_body_slice(transferred + to_transfer);
+            });
+        }
+
+        /// Send the headers of a streamed response and bind its \ref response_stream to this connection.
+        void start_stream()
+        {
+            auto self = this->shared_from_this();
+            auto stream = std::move(res.stream_);
+            const unsigned generation = ++stream_generation_;
+            stream_ = stream;
+            streaming_ = true;
+            stream_chunked_ = res.headers.count("Transfer-Encoding") != 0;
+
+            queue_write(std::move(buffers_), [this, generation](const error_code& ec) {
+                if (ec)
+                    finish_stream(generation, ec);
+            });
+
+            if (res.skip_body)
+            {
+                // HEAD request, there's no body to stream
+                stream->attach(nullptr, nullptr);
+                end_stream(generation);
+                return;
+            }
+
+            // The stream can be used from any thread, its writes are carried out on the connection's thread
+            auto& io_context = adaptor_.get_io_context();
+            stream->open_ = true;
+            stream->attach(
+              [self, generation, &io_context](std::string data, std::function<void(bool)> on_written) {
+                  asio::dispatch(io_context, [self, generation, data = std::move(data), on_written = std::move(on_written)]() mutable {
+                      self->write_stream_chunk(generation, std::move(data), std::move(on_written));
+                  });
+              },
+              [self, generation, &io_context] {
+                  asio::dispatch(io_context, [self, generation] {
+                      self->end_stream(generation);
+                  });
+              });
+        }
+
+        /// Queue one part of a streamed body, framed as a chunk unless the client speaks HTTP/1.0.
+        void write_stream_chunk(unsigned generation, std::string data, std::function<void(bool)> on_written)
+        {
+            if (!streaming_ || generation != stream_generation_)
+            {
+                if (on_written)
+                    on_written(false);
+                return;
             }
-            if (close_connection_)
+
+            write_queue_.emplace_back(std::vector<asio::const_buffer>{}, [this, generation, on_written = std::move(on_written)](const error_code& ec) {
+                if (ec)
+                    finish_stream(generation, ec);
+                if (on_written)
+                    on_written(!ec);
+            });
+            // The job owns the data, it stays in place (a deque doesn't move its elements) until it's written
+            auto& job = write_queue_.back();
+            job.payload = std::move(data);
+            if (!job.payload.empty())
+            {
+                if (stream_chunked_)
+                {
+                    char chunk_header[20];
+                    job.chunk_header.assign(chunk_header, snprintf(chunk_header, sizeof(chunk_header), "%zx\r\n", job.payload.size()));
+                    job.buffers.emplace_back(asio::buffer(job.chunk_header));
+                }
+                job.buffers.emplace_back(asio::buffer(job.payload));
+                if (stream_chunked_)
+                    job.buffers.emplace_back(asio::buffer(crlf));
+            }
+            start_writing();
+        }
+
+        /// Queue the end of a streamed body, the response is finished once everything before it has been sent.
+        void end_stream(unsigned generation)
+        {
+            if (!streaming_ || generation != stream_generation_)
+                return;
+
+            static const std::string last_chunk = "0\r\n\r\n";
+            std::vector<asio::const_buffer> buffers;
+            if (stream_chunked_)
+                buffers.emplace_back(asio::buffer(last_chunk));
+            queue_write(std::move(buffers), [this, generation](const error_code& ec) {
+                finish_stream(generation, ec);
+            });
+        }
+
+        /// Detach the stream (further writes fail) and finish the response, either because it ended or because writing failed.
+        void finish_stream(unsigned generation, const error_code& ec)
+        {
+            if (!streaming_ || generation != stream_generation_)
+                return;
+
+            streaming_ = false;
+            if (auto stream = stream_.lock())
+                stream->open_ = false;
+            stream_.reset();
+            if (ec)
+            {
+                CROW_LOG_ERROR << ec << " - buffer write error happened while streaming response. Writing stopped premature.";
+            }
+            finish_response(ec);
+        }
+
+        /// Clean up after a response has been written and carry on with the next request.
+        void finish_response(const error_code& ec)
+        {
+            if (close_connection_ || ec || handler_->is_draining())
             {
                 adaptor_.shutdown_readwrite();
                 adaptor_.close();
-                CROW_LOG_DEBUG << this << " from write (static)";
+                CROW_LOG_DEBUG << this << " from write";
+            }
+
+            reset_response();
+
+            if (need_to_start_read_after_complete_ && adaptor_.is_open())
+            {
+                need_to_start_read_after_complete_ = false;
+                if (buffer_begin_ < buffer_end_)
+                {
+                    // The previous read already contains (part of) the next request
+                    process_buffer();
+                }
+                else
+                {
+                    start_deadline();
+                    waiting_for_request_ = true;
+                    next_read_starts_request_ = true;
+                    do_read();
+                }
             }
+        }
 
+        /// Get the response and parser ready for the next request.
+        void reset_response()
+        {
             res.end();
             res.clear();
+            res_body_copy_.clear();
+#ifdef CROW_ENABLE_COMPRESSION
+            compressed_body_.clear();
+#endif
             buffers_.clear();
             parser_.clear();
+            if (body_stream_)
+            {
+                body_stream_->resume_handler_ = nullptr;
+                body_stream_.reset();
+            }
+            body_read_paused_ = false;
         }
 
-        void do_write_general()
+        /// Read more of the request, or wait for the next one.
+
+        ///
+        /// Between requests the connection gives its buffer back and waits for the socket to become readable before taking one again,
+        /// so that idle keep-alive connections don't hold any.
+        /// (Encrypted connections keep theirs, the TLS layer may hold data already received from the socket.)
+        void do_read()
         {
-            error_code ec;
-            if (res.body.length() < res_stream_threshold_)
+            if constexpr (!Adaptor::encrypted)
             {
-                res_body_copy_.swap(res.body);
-                buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
-
-                ec = do_write_sync(buffers_);
-                if (ec) {
-                    CROW_LOG_ERROR << ec << " - buffer write error happened while sending response. Writing stopped premature.";
+                if (next_read_starts_request_)
+                {
+                    release_read_buffer();
+                    read_buffer_class_ = 0;
+                    auto self = this->shared_from_this();
+                    adaptor_.raw_socket().async_wait(asio::socket_base::wait_read, [self](const error_code& ec) {
+                        if (ec)
+                        {
+                            self->handle_read_error();
+                            return;
+                        }
+                        self->take_read_buffer();
+                        error_code read_ec;
+                        std::size_t bytes_transferred = self->adaptor_.raw_socket().read_some(asio::buffer(self->read_buffer_, detail::read_buffer_pool::class_size(self->held_buffer_class_)), read_ec);
+                        if (read_ec == asio::error::would_block)
+                            self->do_read();
+                        else
+                            self->on_read(read_ec, bytes_transferred);
+                    });
+                    return;
                 }
-                if (need_to_start_read_after_complete_)
+            }
+
+            if (parser_.content_length != CROW_ULLONG_MAX && parser_.content_length > detail::read_buffer_pool::class_size(read_buffer_class_))
+            {
+                // Within a large body
+                read_buffer_class_ = std::max(read_buffer_class_, detail::read_buffer_pool::class_for(parser_.content_length));
+            }
+            take_read_buffer();
+            auto self = this->shared_from_this();
+            adaptor_.socket().async_read_some(
+              asio::buffer(read_buffer_, detail::read_buffer_pool::class_size(held_buffer_class_)),
+              [self](const error_code& ec, std::size_t bytes_transferred) {
+                  self->on_read(ec, bytes_transferred);
+              });
+        }
+
+        void on_read(const error_code& ec, std::size_t bytes_transferred)
+        {
+            if (ec)
+            {
+                handle_read_error();
+                return;
+            }
+
+            if (bytes_transferred == detail::read_buffer_pool::class_size(held_buffer_class_) && read_buffer_class_ + 1 < detail::read_buffer_pool::size_classes)
+            {
+                // More is coming than the buffer holds, the next read takes a larger one
+                read_buffer_class_++;
+            }
+            waiting_for_request_ = false;
+            if (next_read_starts_request_)
+            {
+                next_read_starts_request_ = false;
+                if (admission_.enabled() && !admission_.admit_request())
                 {
-                    need_to_start_read_after_complete_ = false;
-                    start_deadline();
-                    do_read();
+                    shed();
+                    return;
                 }
             }
+            buffer_begin_ = 0;
+            buffer_end_ = bytes_transferred;
+            process_buffer();
+        }
+
+        /// Make sure the connection holds a read buffer of the wanted size class, only called when the previous read has been parsed.
+        void take_read_buffer()
+        {
+            if (read_buffer_ && held_buffer_class_ != read_buffer_class_)
+                release_read_buffer();
+            if (!read_buffer_)
+            {
+                read_buffer_ = read_buffers_.acquire(read_buffer_class_);
+                held_buffer_class_ = read_buffer_class_;
+            }
+        }
+
+        void release_read_buffer()
+        {
+            if (read_buffer_)
+            {
+                read_buffers_.release(read_buffer_, held_buffer_class_);
+                read_buffer_ = nullptr;
+            }
+        }
+
+        /// Turn the connection away without parsing its request, as the server is handling too many already.
+        void shed()
+        {
+            CROW_LOG_DEBUG << this << " shed, too many requests in flight";
+            cancel_deadline_timer();
+            if constexpr (Adaptor::encrypted)
+            {
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+            }
             else
             {
-                asio::write(adaptor_.socket(), buffers_,ec); // Write the response start / headers
-                if (ec) {
-                    CROW_LOG_ERROR << ec << "- buffer write error happened while sending response start / headers. Writing stopped premature.";
+                detail::shed_connection(std::move(adaptor_.raw_socket()), admission_.shed_response());
+            }
+        }
+
+        /// Feed the unparsed part of the read buffer to the parser, then decide whether to read again or wait for the response.
+
+        ///
+        /// Requests answered right away are handled one after the other without waiting for their responses to be written,
+        /// which then go out together in one write.
+        void process_buffer()
+        {
+            bool ret;
+            bool between_requests; // Everything read so far has been answered
+            for (;;)
+            {
+                feeding_ = true;
+                ret = parser_.feed(read_buffer_ + buffer_begin_, static_cast<int>(buffer_end_ - buffer_begin_));
+                feeding_ = false;
+                buffer_begin_ += parser_.consumed();
+                between_requests = response_pipelined_;
+                if (!response_pipelined_)
+                    break;
+                response_pipelined_ = false;
+                reset_response();
+                if (!ret || buffer_begin_ >= buffer_end_)
+                    break;
+            }
+            start_writing();
+
+            if (!ret || !adaptor_.is_open())
+            {
+                handle_read_error();
+            }
+            else if (body_stream_ && !parser_.message_done())
+            {
+                // The body of a request being handled is still coming in
+                if (body_stream_->paused_)
+                {
+                    cancel_deadline_timer();
+                    body_read_paused_ = true; // resume_body() carries on
                 }
-                cancel_deadline_timer();
-                if (res.body.length() > 0)
+                else
                 {
-                    std::vector<asio::const_buffer> buffers{1};
-                    const uint8_t* data = reinterpret_cast<const uint8_t*>(res.body.data());
-                    size_t length = res.body.length();
-                    for (size_t transferred = 0; transferred < length;)
+                    // The receiver may have taken a break and already be back
+                    parser_.resume_body();
+                    if (buffer_begin_ < buffer_end_)
                     {
-                        size_t to_transfer = CROW_MIN(16384UL, length - transferred);
-                        buffers[0] = asio::const_buffer(data + transferred, to_transfer);
-                        ec = do_write_sync(buffers);
-                        if (ec) {
-                            CROW_LOG_ERROR << ec << " - " << transferred << " - buffer write error happened while sending response. Writing stopped premature.";
-                            break;
-                        }
-                        transferred += to_transfer;
+                        process_buffer();
+                    }
+                    else
+                    {
+                        start_deadline();
+                        do_read();
                     }
                 }
-                if (close_connection_)
+            }
+            else if (close_connection_)
+            {
+                cancel_deadline_timer();
+                parser_.done();
+                // adaptor will close after write
+            }
+            else if (need_to_call_after_handlers_ || parser_.paused() || (is_writing_ && !between_requests))
+            {
+                // res will be completed later by user, or is still being written
+                need_to_start_read_after_complete_ = true;
+            }
+            else
+            {
+                // Pipelined responses may still be being written, the next requests are queued after them
+                start_deadline();
+                if (between_requests)
                 {
-                    adaptor_.shutdown_readwrite();
-                    adaptor_.close();
-                    CROW_LOG_DEBUG << this << " from write (res_stream)";
+                    waiting_for_request_ = true;
+                    next_read_starts_request_ = true;
                 }
+                do_read();
+            }
+        }
+
+        /// Continue receiving a streamed request body after its receiver took a break.
+        void resume_body(const std::shared_ptr<request_body_stream>& stream)
+        {
+            if (!stream || stream != body_stream_ || !body_read_paused_ || !adaptor_.is_open())
+                return;
+
+            body_read_paused_ = false;
+            parser_.resume_body();
+            if (buffer_begin_ < buffer_end_)
+            {
+                process_buffer();
+            }
+            else
+            {
+                start_deadline();
+                do_read();
+            }
+        }
 
-                res.end();
-                res.clear();
-                buffers_.clear();
-                parser_.clear();
+        void handle_read_error()
+        {
+            cancel_deadline_timer();
+            parser_.done();
+            adaptor_.shutdown_read();
+            if (is_writing_)
+            {
+                // Let the pending response go out first, the adaptor will close after write
+                close_connection_ = true;
+                if (write_queue_.back().coalesce)
+                {
+                    // No response is being prepared, the last one queued closes the connection
+                    write_queue_.back().on_written = [this](const error_code&) {
+                        adaptor_.shutdown_readwrite();
+                        adaptor_.close();
+                    };
+                }
             }
+            else
+            {
+                adaptor_.close();
+            }
+            CROW_LOG_DEBUG << this << " from read(1) with description: \"" << http_errno_description(static_cast<http_errno>(parser_.http_errno)) << '\"';
         }
 
-        void do_read()
+        /// Queue a buffer sequence to be written once every write queued before it has completed.
+
+        ///
+        /// `on_written` is called on the connection's io_context when all buffers are sent, or when the write failed.
+        /// The memory referenced by the buffers must stay valid until then.
+        /// The write in progress keeps the connection alive, so `on_written` doesn't hold a reference to it (the queue would never let go of the connection if the io_context is destroyed first).
+        void queue_write(std::vector<asio::const_buffer> buffers, std::function<void(const error_code&)> on_written)
         {
-            auto self = this->shared_from_this();
-            adaptor_.socket().async_read_some(
-              asio::buffer(buffer_),
-              [self](const error_code& ec, std::size_t bytes_transferred) {
-                  bool error_while_reading = true;
-                  if (!ec)
-                  {
-                      bool ret = self->parser_.feed(self->buffer_.data(), bytes_transferred);
-                      if (ret && self->adaptor_.is_open())
-                      {
-                          error_while_reading = false;
-                      }
-                  }
-
-                  if (error_while_reading)
-                  {
-                      self->cancel_deadline_timer();
-                      self->parser_.done();
-                      self->adaptor_.shutdown_read();
-                      self->adaptor_.close();
-                      CROW_LOG_DEBUG << self << " from read(1) with description: \"" << http_errno_description(static_cast<http_errno>(self->parser_.http_errno)) << '\"';
-                  }
-                  else if (self->close_connection_)
-                  {
-                      self->cancel_deadline_timer();
-                      self->parser_.done();
-                      // adaptor will close after write
-                  }
-                  else if (!self->need_to_call_after_handlers_)
-                  {
-                      self->start_deadline();
-                      self->do_read();
-                  }
-                  else
-                  {
-                      // res will be completed later by user
-                      self->need_to_start_read_after_complete_ = true;
-                  }
-              });
+            write_queue_.emplace_back(std::move(buffers), std::move(on_written));
+            start_writing();
+        }
+
+        /// Queue `count` bytes of the open file `fd` starting at `offset` to be sent with the adaptor's sendfile support.
+        void queue_sendfile(int fd, off_t offset, size_t count, std::function<void(const error_code&)> on_written)
+        {
+            auto& job = write_queue_.emplace_back(std::vector<asio::const_buffer>{}, std::move(on_written));
+            job.file_fd = fd;
+            job.file_offset = offset;
+            job.file_count = count;
+            start_writing();
+        }
+
+        /// Start writing the queued jobs, unless a write is in progress or the parser is still running (the jobs queued meanwhile are written together).
+        void start_writing()
+        {
+            if (!is_writing_ && !feeding_ && !write_queue_.empty())
+            {
+                do_write();
+            }
         }
 
         void do_write()
         {
+            is_writing_ = true;
+            jobs_in_flight_ = 1;
             auto self = this->shared_from_this();
+            auto& job = write_queue_.front();
+            if (job.coalesce && write_queue_.size() > 1)
+            {
+                // Pipelined responses go out in a single write, along with the job after the last of them
+                gathered_buffers_.clear();
+                jobs_in_flight_ = 0;
+                for (auto& queued : write_queue_)
+                {
+                    if (queued.file_fd >= 0)
+                        break;
+                    gathered_buffers_.insert(gathered_buffers_.end(), queued.buffers.begin(), queued.buffers.end());
+                    jobs_in_flight_++;
+                    if (!queued.coalesce)
+                        break;
+                }
+                asio::async_write(
+                  adaptor_.socket(), detail::buffer_range(gathered_buffers_),
+                  [self](const error_code& ec, std::size_t /*bytes_transferred*/) {
+                      self->on_write_complete(ec);
+                  });
+                return;
+            }
+            if constexpr (Adaptor::supports_sendfile)
+            {
+                if (job.file_fd >= 0)
+                {
+                    adaptor_.async_sendfile(job.file_fd, job.file_offset, job.file_count, [self](const error_code& ec, std::size_t /*bytes_transferred*/) {
+                        self->on_write_complete(ec);
+                    });
+                    return;
+                }
+            }
             asio::async_write(
-              adaptor_.socket(), buffers_,
+              adaptor_.socket(), detail::buffer_range(job.buffers),
               [self](const error_code& ec, std::size_t /*bytes_transferred*/) {
-                  self->res.clear();
-                  self->res_body_copy_.clear();
-                  if (!self->continue_requested)
-                  {
-                      self->parser_.clear();
-                  }
-                  else
-                  {
-                      self->continue_requested = false;
-                  }
-
-                  if (!ec)
-                  {
-                      if (self->close_connection_)
-                      {
-                          self->adaptor_.shutdown_write();
-                          self->adaptor_.close();
-                          CROW_LOG_DEBUG << self << " from write(1)";
-                      }
-                  }
-                  else
-                  {
-                      CROW_LOG_DEBUG << self << " from write(2)";
-                  }
+                  self->on_write_complete(ec);
               });
         }
 
-        inline error_code do_write_sync(std::vector<asio::const_buffer>& buffers)
+        void on_write_complete(const error_code& ec)
         {
-            error_code ec;
-            asio::write(adaptor_.socket(), buffers, ec);
             if (ec)
             {
-                // CROW_LOG_ERROR << ec << " - happened while sending buffers";
-                CROW_LOG_DEBUG << this << " from write (sync)(2)";
+                CROW_LOG_DEBUG << this << " from write(2)";
             }
-
-            this->res.clear();
-            this->res_body_copy_.clear();
-            if (this->continue_requested)
+            // The buffer of written pipelined responses is kept for the next ones
+            auto keep_buffer = [this](write_job& job) {
+                if (job.coalesce && job.payload.capacity() > spare_pipelined_buffer_.capacity())
+                {
+                    job.payload.clear();
+                    spare_pipelined_buffer_.swap(job.payload);
+                }
+                if (job.coalesce && job.buffers.capacity() > spare_pipelined_buffers_.capacity())
+                    spare_pipelined_buffers_.swap(job.buffers);
+            };
+            // The pipelined responses written along with the last job only have to hear about errors
+            for (; jobs_in_flight_ > 1; jobs_in_flight_--)
             {
-                this->continue_requested = false;
+                auto job = std::move(write_queue_.front());
+                write_queue_.pop_front();
+                job.on_written(ec);
+                keep_buffer(job);
             }
-            else
+            auto job = std::move(write_queue_.front());
+            write_queue_.pop_front();
+            is_writing_ = false;
+
+            job.on_written(ec);
+            keep_buffer(job);
+
+            if (!is_writing_)
             {
-                this->parser_.clear();
+                if (!write_queue_.empty())
+                {
+                    do_write();
+                }
+                else if (need_to_start_read_after_complete_ && !need_to_call_after_handlers_ && !parser_.paused() && adaptor_.is_open())
+                {
+                    // Nothing left to send and no response pending (e.g. after 100-continue), resume reading.
+                    need_to_start_read_after_complete_ = false;
+                    start_deadline();
+                    do_read();
+                }
             }
+        }
 
-            return ec;
+        /// Get a descriptor for the static file, reusing the one held by the static file cache if there is one.
+        bool open_static_file_fd()
+        {
+            if (res.file_info.cached && res.file_info.cached->file && res.file_info.cached->file->fd() >= 0)
+                static_file_handle_ = res.file_info.cached->file;
+            else
+                static_file_handle_ = std::make_shared<detail::file_handle>(res.file_info.path);
+            return static_file_handle_->fd() >= 0;
+        }
+
+        void close_static_file_fd()
+        {
+            static_file_handle_.reset();
         }
 
         void cancel_deadline_timer()
@@ -514,25 +1289,73 @@ namespace crow
         Adaptor adaptor_;
         Handler* handler_;
 
-        std::array<char, 4096> buffer_;
+        char* read_buffer_{};          ///< Taken from `read_buffers_` while the connection reads, see do_read().
+        unsigned held_buffer_class_{}; ///< The size class of `read_buffer_`.
+        unsigned read_buffer_class_{}; ///< The size class of the buffer for the next read.
+        size_t buffer_begin_{};        ///< Start of the bytes in read_buffer_ which were not parsed yet.
+        size_t buffer_end_{};
 
         HTTPParser<Connection> parser_;
-        std::unique_ptr<routing_handle_result> routing_handle_result_;
+        std::shared_ptr<Connection> self_until_complete_; ///< Set while a handler that isn't offloaded has yet to complete its response.
+        detail::request_arena arena_; ///< Memory for the data of the request being handled, reset when the next request's URL arrives.
+        routing_handle_result routing_handle_result_{routing_handle_result::allocator_type(&arena_)};
         request& req_;
         response res;
 
         bool close_connection_ = false;
 
-        const std::string& server_name_;
+        const std::string& server_header_; ///< The whole `Server` header line, empty for none.
         std::vector<asio::const_buffer> buffers_;
 
-        std::string content_length_;
-        std::string date_str_;
+        struct write_job
+        {
+            write_job(std::vector<asio::const_buffer> job_buffers, std::function<void(const error_code&)> callback):
+              buffers(std::move(job_buffers)), on_written(std::move(callback))
+            {}
+
+            std::vector<asio::const_buffer> buffers;
+            std::function<void(const error_code&)> on_written;
+            int file_fd = -1; ///< If set, the job sends part of this file instead of the buffers.
+            off_t file_offset = 0;
+            size_t file_count = 0;
+            std::string chunk_header; ///< Owned data of a streamed body part, referenced by `buffers`.
+            std::string payload;
+            bool coalesce = false; ///< Whole responses owning their data (`payload` and `body`), written along with the jobs after them.
+            std::string body;      ///< The body of the last response in a coalesced job, if it's too large to be copied.
+        };
+        std::deque<write_job> write_queue_;
+        bool is_writing_{};
+        bool feeding_{};                                   ///< Set while the parser runs, the jobs queued meanwhile wait for it to finish.
+        bool response_pipelined_{};                        ///< Set when \ref queue_pipelined_response() queued the response while the parser ran.
+        size_t jobs_in_flight_{1};                         ///< Number of jobs from the front of the queue in the current write.
+        std::vector<asio::const_buffer> gathered_buffers_; ///< The buffers of several jobs written at once.
+        std::string spare_pipelined_buffer_;               ///< The buffer of written pipelined responses, for the next ones.
+        std::vector<asio::const_buffer> spare_pipelined_buffers_; ///< The buffer sequence of written pipelined responses, for the next ones.
+        static constexpr size_t pipelined_body_copy_limit = 16384;
+
+        std::ifstream static_file_; ///< Used when the adaptor can't send files directly.
+        std::string static_file_buffer_;
+        size_t static_file_range_{};        ///< Index of the next range to send through `static_file_`.
+        uint64_t static_file_remaining_{}; ///< Bytes of the current range still to be sent through `static_file_`.
+        std::shared_ptr<const detail::file_handle> static_file_handle_; ///< Kept alive until the file has been sent.
+
+        std::shared_ptr<request_body_stream> body_stream_; ///< Set while handling a request whose body is streamed to the handler.
+        bool body_read_paused_{};                          ///< Whether reading stopped because the body's receiver is taking a break.
+
+        std::weak_ptr<response_stream> stream_; ///< The stream of the response being sent, owned by the user.
+        unsigned stream_generation_{};          ///< Tells a stream apart from those of previous responses on this connection.
+        bool streaming_{};
+        bool stream_chunked_{};
+
+        std::string header_block_; ///< The status line and headers of the response being sent.
+        std::shared_ptr<const std::string> date_line_; ///< The `Date` header line of the response being sent, kept until it's sent.
         std::string res_body_copy_;
+#ifdef CROW_ENABLE_COMPRESSION
+        compression::chunked_buffer compressed_body_; ///< The response body as it is sent, if it was compressed.
+#endif
 
         detail::task_timer::identifier_type task_id_{};
 
-        bool continue_requested{};
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
@@ -540,12 +1363,25 @@ namespace crow
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
 
-        std::function<std::string()>& get_cached_date_str;
+        detail::date_header& date_header_;
         detail::task_timer& task_timer_;
+        detail::read_buffer_pool& read_buffers_;
 
         size_t res_stream_threshold_;
 
-        std::atomic<unsigned int>& queue_length_;
+        detail::worker_load_counters& load_;
+        bool request_pending_{}; ///< Whether the current request is counted in `load_`.
+        bool waiting_for_request_{}; ///< Whether the connection is idle between requests.
+        bool next_read_starts_request_{}; ///< Whether the data being read is the start of a new request, see \ref detail::admission_control::admit_request().
+        std::chrono::steady_clock::time_point request_start_;
+
+        detail::connection_list& connections_;
+
+        detail::admission_control& admission_;
+        bool admitted_{false};
+        bool peer_is_ip_{false};
+        asio::ip::address peer_address_;
+        std::string remote_ip_address_; ///< The client's address, formatted once for all of the connection's requests.
     };
 
 } // namespace crow
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CROW_FAST_PARSER_AVX2
+#endif
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define CROW_FAST_PARSER_SSE42
+#endif
+
+#include "crow/common.h"
+#include "crow/http_parser_merged.h"
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    namespace detail
+    {
+        /// The parts of a request head found by \ref parse_request_head(), positions are from the start of the buffer.
+        struct request_head
+        {
+            static constexpr std::size_t max_headers = 64; ///< Requests with more headers are left to the state machine.
+
+            struct header
+            {
+                uint32_t name;
+                uint32_t name_length;
+                uint32_t value;
+                uint32_t value_length;
+            };
+
+            HTTPMethod method;
+            uint32_t url;
+            uint32_t url_length;
+            uint32_t qs_point; ///< The position of the first '?' in the URL, 0 if there isn't one.
+            unsigned char http_major;
+            unsigned char http_minor;
+            unsigned int flags;      ///< `F_CONNECTION_KEEP_ALIVE`, `F_CONNECTION_CLOSE` and `F_CONTENTLENGTH`.
+            uint64_t content_length; ///< `CROW_ULLONG_MAX` if there is no Content-Length header.
+            std::size_t length;      ///< Up to and including the line feed of the empty line ending the head.
+            std::size_t header_count;
+            header headers[max_headers];
+        };
+
+        namespace head_scan
+        {
+            /// Which bytes end a run of characters, built from the same rules the state machine applies one byte at a time.
+            struct char_class
+            {
+                bool stop[256];
+            };
+
+            constexpr char_class make_url_class()
+            {
+                // Path and query string characters, the query string may contain more '?'
+                char_class c{};
+                for (int i = 0; i < 256; i++)
+                    c.stop[i] = i <= ' ' || i >= 0x7f || i == '#';
+                return c;
+            }
+
+            constexpr char_class make_token_class()
+            {
+                char_class c{};
+                for (int i = 0; i < 256; i++)
+                    c.stop[i] = i <= ' ' || i >= 0x7f;
+                for (char separator : "\"(),/:;<=>?@[\\]{}")
+                    c.stop[static_cast<unsigned char>(separator)] = true;
+                return c;
+            }
+
+            constexpr char_class make_value_class()
+            {
+                char_class c{};
+                for (int i = 0; i < 256; i++)
+                    c.stop[i] = (i < ' ' && i != '\t') || i == 0x7f;
+                return c;
+            }
+
+            constexpr char_class url_chars = make_url_class();
+            constexpr char_class token_chars = make_token_class();
+            constexpr char_class value_chars = make_value_class();
+
+#ifdef CROW_FAST_PARSER_SSE42
+            /// Skip 16 bytes at a time until one falls into one of the byte `ranges` (pairs of first and last byte).
+            inline const char* skip_ranges(const char* p, const char* end, const char* ranges, int ranges_size)
+            {
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranges));
+                for (; end - p >= 16; p += 16)
+                {
+                    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                    int i = _mm_cmpestri(r, ranges_size, b, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+                    if (i != 16)
+                        return p + i;
+                }
+                return p;
+            }
+#endif
+
+#ifdef CROW_FAST_PARSER_AVX2
+            /// Skip 32 bytes at a time until one is at most `low`, at least `high` or equal to `extra`.
+            inline const char* skip_outside(const char* p, const char* end, char low, char high, char extra)
+            {
+                const __m256i l = _mm256_set1_epi8(low), h = _mm256_set1_epi8(high), x = _mm256_set1_epi8(extra);
+                for (; end - p >= 32; p += 32)
+                {
+                    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                    const __m256i below = _mm256_cmpeq_epi8(_mm256_min_epu8(b, l), b);
+                    const __m256i above = _mm256_cmpeq_epi8(_mm256_max_epu8(b, h), b);
+                    const __m256i stop = _mm256_or_si256(_mm256_or_si256(below, above), _mm256_cmpeq_epi8(b, x));
+                    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(stop));
+                    if (mask)
+                        return p + __builtin_ctz(mask);
+                }
+                return p;
+            }
+#endif
+
+            // The vector loops stop where the run might end, or where too few bytes are left for them.
+            // They may stop early at a byte that's allowed after all, which \ref find_end() steps over.
+
+            inline const char* skip_url(const char* p, const char* end)
+            {
+#if defined(CROW_FAST_PARSER_AVX2)
+                return skip_outside(p, end, ' ', '\x7f', '#');
+#elif defined(CROW_FAST_PARSER_SSE42)
+                static const char ranges[16] = {'\x00', ' ', '#', '#', '\x7f', '\xff'};
+                return skip_ranges(p, end, ranges, 6);
+#else
+                (void)end;
+                return p;
+#endif
+            }
+
+            inline const char* skip_token(const char* p, const char* end)
+            {
+#ifdef CROW_FAST_PARSER_SSE42
+                // '|' and '~' are in the last range but are token characters
+                static const char ranges[16] = {'\x00', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', '\xff'};
+                return skip_ranges(p, end, ranges, 16);
+#else
+                (void)end;
+                return p;
+#endif
+            }
+
+            inline const char* skip_value(const char* p, const char* end)
+            {
+#if defined(CROW_FAST_PARSER_AVX2)
+                // Stops at tabs and at 0xff too
+                return skip_outside(p, end, '\x1f', '\xff', '\x7f');
+#elif defined(CROW_FAST_PARSER_SSE42)
+                // Stops at tabs too
+                static const char ranges[16] = {'\x00', '\x1f', '\x7f', '\x7f'};
+                return skip_ranges(p, end, ranges, 4);
+#else
+                (void)end;
+                return p;
+#endif
+            }
+
+            /// Find the first byte from `p` that isn't one of `chars`, or `end`.
+            template<typename Skip>
+            inline const char* find_end(const char* p, const char* end, const char_class& chars, Skip skip)
+            {
+                for (;; p++)
+                {
+                    p = skip(p, end);
+                    if (p == end || chars.stop[static_cast<unsigned char>(*p)])
+                        return p;
+                }
+            }
+
+            inline bool is_digit(char c)
+            {
+                return c >= '0' && c <= '9';
+            }
+
+            /// Compare a header name or value with a lowercase string, ignoring case.
+            inline bool iequals_prefix(const char* p, std::size_t length, const char* lower, std::size_t lower_length)
+            {
+                if (length < lower_length)
+                    return false;
+                for (std::size_t i = 0; i < lower_length; i++)
+                {
+                    if ((p[i] | 0x20) != lower[i])
+                        return false;
+                }
+                return true;
+            }
+
+            inline bool only_spaces(const char* p, const char* end)
+            {
+                for (; p != end; p++)
+                {
+                    if (*p != ' ')
+                        return false;
+                }
+                return true;
+            }
+        } // namespace head_scan
+
+        /// Find the parts of a request head that is already complete in `data`, skipping over its characters many at a time.
+
+        ///
+        /// Only the common requests are taken: a known method, an origin-form URL, an `HTTP/x.y` version,
+        /// headers without line folding, `Connection` and `Content-Length` but not `Transfer-Encoding` or `Upgrade`.
+        /// Returns false for anything else, including heads that are incomplete or longer than `max_size`,
+        /// and leaves those to the state machine in "crow/http_parser_merged.h", which then accepts or rejects them as usual.
+        /// For the heads it takes, the result is what the state machine would have found.
+        inline bool parse_request_head(const char* data, std::size_t length, std::size_t max_size, request_head& head)
+        {
+            using namespace head_scan;
+            struct method_name
+            {
+                const char* name;
+                std::size_t length;
+                HTTPMethod method;
+            };
+            static const method_name methods[] = {
+              {"GET ", 4, HTTPMethod::Get},
+              {"POST ", 5, HTTPMethod::Post},
+              {"PUT ", 4, HTTPMethod::Put},
+              {"DELETE ", 7, HTTPMethod::Delete},
+              {"HEAD ", 5, HTTPMethod::Head},
+              {"OPTIONS ", 8, HTTPMethod::Options},
+              {"PATCH ", 6, HTTPMethod::Patch},
+            };
+
+            const char* const end = data + (length < max_size ? length : max_size);
+            const char* p = data;
+
+            // Request line
+            const method_name* method = nullptr;
+            for (const method_name& m : methods)
+            {
+                if (static_cast<std::size_t>(end - p) > m.length && std::memcmp(p, m.name, m.length) == 0)
+                {
+                    method = &m;
+                    break;
+                }
+            }
+            if (!method)
+                return false;
+            head.method = method->method;
+            p += method->length;
+            if (*p != '/')
+                return false;
+            const char* url_end = find_end(p + 1, end, url_chars, skip_url);
+            if (end - url_end < 11 || std::memcmp(url_end, " HTTP/", 6) != 0 ||
+                !is_digit(url_end[6]) || url_end[7] != '.' || !is_digit(url_end[8]) ||
+                url_end[9] != '\r' || url_end[10] != '\n')
+                return false;
+            head.url = static_cast<uint32_t>(p - data);
+            head.url_length = static_cast<uint32_t>(url_end - p);
+            const void* question_mark = std::memchr(p, '?', head.url_length);
+            head.qs_point = question_mark ? static_cast<uint32_t>(static_cast<const char*>(question_mark) - p) : 0;
+            head.http_major = static_cast<unsigned char>(url_end[6] - '0');
+            head.http_minor = static_cast<unsigned char>(url_end[8] - '0');
+            p = url_end + 11;
+
+            // Headers
+            head.flags = 0;
+            head.content_length = CROW_ULLONG_MAX;
+            head.header_count = 0;
+            for (;;)
+            {
+                if (p == end)
+                    return false;
+                if (*p == '\r')
+                {
+                    if (end - p < 2 || p[1] != '\n')
+                        return false;
+                    head.length = p + 2 - data;
+                    return true;
+                }
+                if (head.header_count == request_head::max_headers)
+                    return false;
+
+                const char* name = p;
+                const char* name_end = find_end(p, end, token_chars, skip_token);
+                if (name_end == name || name_end == end || *name_end != ':')
+                    return false;
+                const std::size_t name_length = name_end - name;
+
+                p = name_end + 1;
+                while (p != end && (*p == ' ' || *p == '\t'))
+                    p++;
+                const char* value = p;
+                const char* value_end = find_end(p, end, value_chars, skip_value);
+                // The next line must be there and not continue this one
+                if (end - value_end < 3 || value_end[0] != '\r' || value_end[1] != '\n' || value_end[2] == ' ' || value_end[2] == '\t')
+                    return false;
+                const std::size_t value_length = value_end - value;
+
+                // The state machine takes any name starting with it as Transfer-Encoding
+                if (iequals_prefix(name, name_length, "transfer-encoding", 17))
+                    return false;
+                switch (name_length)
+                {
+                    case 7:
+                        if (iequals_prefix(name, name_length, "upgrade", 7))
+                            return false;
+                        break;
+                    case 10:
+                        if (iequals_prefix(name, name_length, "connection", 10))
+                        {
+                            if (iequals_prefix(value, value_length, "keep-alive", 10) && only_spaces(value + 10, value_end))
+                                head.flags |= F_CONNECTION_KEEP_ALIVE;
+                            else if (iequals_prefix(value, value_length, "close", 5) && only_spaces(value + 5, value_end))
+                                head.flags |= F_CONNECTION_CLOSE;
+                        }
+                        break;
+                    case 14:
+                        if (iequals_prefix(name, name_length, "content-length", 14) && value_length)
+                        {
+                            // Longer numbers and repeated headers get the state machine's checks
+                            const char* digits_end = value;
+                            while (digits_end != value_end && is_digit(*digits_end))
+                                digits_end++;
+                            if (digits_end == value || digits_end - value > 18 || !only_spaces(digits_end, value_end) || (head.flags & F_CONTENTLENGTH))
+                                return false;
+                            head.flags |= F_CONTENTLENGTH;
+                            head.content_length = 0;
+                            for (const char* d = value; d != digits_end; d++)
+                                head.content_length = head.content_length * 10 + static_cast<uint64_t>(*d - '0');
+                        }
+                        break;
+                    case 16:
+                        if (iequals_prefix(name, name_length, "proxy-connection", 16))
+                            return false;
+                        break;
+                    default:
+                        break;
+                }
+
+                head.headers[head.header_count++] = {static_cast<uint32_t>(name - data), static_cast<uint32_t>(name_length),
+                                                     static_cast<uint32_t>(value - data), static_cast<uint32_t>(value_length)};
+                p = value_end + 2;
+            }
+        }
+    } // namespace detail
+} // namespace crow
@@ -130,6 +130,7 @@ enum http_connection_flags // This is basically 7 booleans placed into 1 integer
   CROW_XX(STRICT, "strict mode assertion failed")                                       \
   CROW_XX(UNKNOWN, "an unknown error occurred")                                         \
   CROW_XX(INVALID_TRANSFER_ENCODING, "request has invalid transfer-encoding")           \
+  CROW_XX(PAUSED, "parser is paused")                                                   \
 
 
 /* Define CHPE_* values for each errno value above */
@@ -1936,6 +1937,24 @@ inline void
   parser->http_errno = CHPE_OK;
 }
 
+/* Pause or un-pause the parser; a nonzero value pauses.
+ * A paused parser consumes no input until it is un-paused.
+ */
+inline void
+  http_parser_pause(http_parser* parser, int paused)
+{
+  /* Users should only be pausing/unpausing a parser that is not in an error
+   * state. In non-debug builds, there's not much that we can do about this
+   * other than ignore it.
+   */
+  if (CROW_HTTP_PARSER_ERRNO(parser) == CHPE_OK ||
+      CROW_HTTP_PARSER_ERRNO(parser) == CHPE_PAUSED) {
+    parser->http_errno = (paused) ? CHPE_PAUSED : CHPE_OK;
+  } else {
+    assert(0 && "Attempting to pause parser in error state");
+  }
+}
+
 /* Return a string name of the given error */
 inline const char *
 http_errno_name(enum http_errno err) {
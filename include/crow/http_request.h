@@ -10,6 +10,11 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
 
 #include "crow/common.h"
 #include "crow/ci_map.h"
@@ -21,6 +26,26 @@ namespace crow // NOTE: Already documented in "crow/app.h"
     namespace asio = boost::asio;
 #endif
 
+    namespace detail
+    {
+        class task_timer;
+
+        /// Where a header's name and value are in a request's header data, offsets stay valid when the request is copied.
+        struct header_span
+        {
+            uint32_t name;
+            uint32_t name_length;
+            uint32_t value;
+            uint32_t value_length;
+        };
+    } // namespace detail
+
+    template<typename Adaptor, typename Handler, typename... Middlewares>
+    class Connection;
+
+    template<typename Handler>
+    struct HTTPParser;
+
     /// Remove CR (\r) and LF (\n) characters from a header name or value to prevent header injection.
     inline void sanitize_header_value(std::string& s)
     {
@@ -42,6 +67,53 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
     }
 
+    /// The body of a request, handed over while it's being received (see \ref request::body_stream).
+    class request_body_stream
+    {
+    public:
+        /// Set the function receiving the body.
+
+        ///
+        /// It's called on the connection's thread with each part of the body as it arrives, then once with `complete` set and no data.
+        /// The data is only valid during the call.
+        void on_data(std::function<void(std::string_view data, bool complete)> handler)
+        {
+            handler_ = std::move(handler);
+        }
+
+        /// Stop receiving the body until \ref resume() is called, e.g. while the data can't be processed as fast as it arrives.
+
+        ///
+        /// Nothing is read from the client in the meantime. Can be called from any thread.
+        void pause()
+        {
+            paused_ = true;
+        }
+
+        /// Carry on receiving the body. Can be called from any thread.
+        void resume()
+        {
+            bool paused = true;
+            if (paused_.compare_exchange_strong(paused, false) && resume_handler_)
+                resume_handler_();
+        }
+
+        /// Whether the whole body has been received.
+        bool complete() const
+        {
+            return complete_;
+        }
+
+    private:
+        template<typename Adaptor, typename Handler, typename... Middlewares>
+        friend class crow::Connection;
+
+        std::function<void(std::string_view, bool)> handler_;
+        std::function<void()> resume_handler_;
+        std::atomic<bool> paused_{false};
+        std::atomic<bool> complete_{false};
+    };
+
     /// An HTTP request.
     struct request
     {
@@ -49,7 +121,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         std::string raw_url;     ///< The full URL containing the `?` and URL parameters.
         std::string url;         ///< The endpoint without any parameters.
         query_string url_params; ///< The parameters associated with the request. (everything after the `?` in the URL)
-        ci_map headers;
+        mutable ci_map headers;  ///< With request views (see \ref Crow::request_views()), only filled by \ref get_headers() or \ref get_header_value().
         std::string body;
         std::string remote_ip_address; ///< The IP address from which the request was sent.
         unsigned char http_ver_major, http_ver_minor;
@@ -60,6 +132,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         void* middleware_context{};
         void* middleware_container{};
         asio::io_context* io_context{};
+        detail::task_timer* task_timer{}; ///< The timer of the thread handling the request, only to be used from that thread.
+        std::shared_ptr<request_body_stream> body_stream; ///< Set for routes using `stream_body()`, the body then arrives through it instead of \ref body.
 
         /// Construct an empty request. (sets the method to `GET`)
         request():
@@ -75,12 +149,78 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         {
             sanitize_header_value(key);
             sanitize_header_value(value);
+            if (header_views_)
+            {
+                add_header_view(key, value);
+                if (!headers_copied_)
+                    return;
+            }
             headers.emplace(std::move(key), std::move(value));
         }
 
         const std::string& get_header_value(const std::string& key) const
         {
-            return crow::get_header_value(headers, key);
+            return crow::get_header_value(get_headers(), key);
+        }
+
+        /// The value of the header `key` (case-insensitive), empty if there's none.
+
+        ///
+        /// With request views (see \ref Crow::request_views()) nothing is copied, the value stays valid as long as the request.
+        std::string_view header(std::string_view key) const
+        {
+            if (!header_views_)
+                return crow::get_header_value(headers, std::string(key));
+            for (const auto& span : header_spans_)
+            {
+                if (utility::string_equals(header_name(span), key))
+                    return header_value(span);
+            }
+            return {};
+        }
+
+        /// The number of headers named `key` (case-insensitive).
+        size_t header_count(std::string_view key) const
+        {
+            if (!header_views_)
+                return headers.count(std::string(key));
+            return static_cast<size_t>(std::count_if(header_spans_.begin(), header_spans_.end(), [&](const detail::header_span& span) {
+                return utility::string_equals(header_name(span), key);
+            }));
+        }
+
+        /// All headers, copied into \ref headers on first use with request views.
+        const ci_map& get_headers() const
+        {
+            if (header_views_ && !headers_copied_)
+            {
+                for (const auto& span : header_spans_)
+                    headers.emplace(std::string(header_name(span)), std::string(header_value(span)));
+                headers_copied_ = true;
+            }
+            return headers;
+        }
+
+        /// Get ready for the next request on the same connection, keeping the memory of the URL, body, header views and remote address.
+        void recycle()
+        {
+            std::string raw_url_buffer = std::move(raw_url), url_buffer = std::move(url), body_buffer = std::move(body), header_data = std::move(header_data_), address_buffer = std::move(remote_ip_address);
+            std::vector<detail::header_span> header_spans = std::move(header_spans_);
+            bool header_views = header_views_;
+            *this = request();
+            raw_url_buffer.clear();
+            url_buffer.clear();
+            body_buffer.clear();
+            header_data.clear();
+            address_buffer.clear();
+            header_spans.clear();
+            raw_url = std::move(raw_url_buffer);
+            url = std::move(url_buffer);
+            body = std::move(body_buffer);
+            header_data_ = std::move(header_data);
+            remote_ip_address = std::move(address_buffer);
+            header_spans_ = std::move(header_spans);
+            header_views_ = header_views;
         }
 
         bool check_version(unsigned char major, unsigned char minor) const
@@ -110,5 +250,31 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         {
             asio::dispatch(io_context, handler);
         }
+
+    private:
+        template<typename Handler>
+        friend struct HTTPParser;
+
+        std::string_view header_name(const detail::header_span& span) const
+        {
+            return std::string_view(header_data_.data() + span.name, span.name_length);
+        }
+
+        std::string_view header_value(const detail::header_span& span) const
+        {
+            return std::string_view(header_data_.data() + span.value, span.value_length);
+        }
+
+        void add_header_view(std::string_view name, std::string_view value)
+        {
+            header_spans_.push_back({static_cast<uint32_t>(header_data_.size()), static_cast<uint32_t>(name.size()), static_cast<uint32_t>(header_data_.size() + name.size()), static_cast<uint32_t>(value.size())});
+            header_data_.append(name);
+            header_data_.append(value);
+        }
+
+        bool header_views_ = false;          ///< Whether headers are kept in `header_data_` in place of \ref headers.
+        mutable bool headers_copied_ = false; ///< Whether \ref headers has been filled from the views.
+        std::string header_data_;             ///< Header names and values back to back.
+        std::vector<detail::header_span> header_spans_;
     };
 } // namespace crow
@@ -1,6 +1,16 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <ios>
 #include <fstream>
 #include <sstream>
@@ -20,6 +30,8 @@
 #include "crow/logging.h"
 #include "crow/mime_types.h"
 #include "crow/returnable.h"
+#include "crow/static_file_cache.h"
+#include "crow/utility.h"
 
 
 namespace crow
@@ -35,6 +47,195 @@ namespace crow
 
     class Router;
 
+    namespace detail
+    {
+        /// The `Date` header line of a worker thread's responses, formatted at most once per second.
+
+        ///
+        /// A line is never changed once formatted, so a response that is still being sent keeps referencing its own while the next one is formatted.
+        class date_header
+        {
+        public:
+            /// The line for the current second, `Date: <IMF-fixdate>\r\n\r\n`, the empty line ending the headers included.
+            const std::shared_ptr<const std::string>& line()
+            {
+                std::time_t now = std::time(nullptr);
+                if (now != second_ || !line_)
+                {
+                    second_ = now;
+                    line_ = std::make_shared<const std::string>("Date: " + utility::format_http_date(now) + "\r\n\r\n");
+                }
+                return line_;
+            }
+
+        private:
+            std::time_t second_{};
+            std::shared_ptr<const std::string> line_;
+        };
+
+        /// The status line of a status code, empty for the codes Crow doesn't know.
+        inline std::string_view status_line(int code)
+        {
+            // Keep in sync with common.h/status
+            static const std::array<std::string_view, 600> lines = [] {
+                std::array<std::string_view, 600> table{};
+                static const std::pair<int, std::string_view> known[] = {
+                  {status::CONTINUE, "HTTP/1.1 100 Continue\r\n"},
+                  {status::SWITCHING_PROTOCOLS, "HTTP/1.1 101 Switching Protocols\r\n"},
+                  {status::OK, "HTTP/1.1 200 OK\r\n"},
+                  {status::CREATED, "HTTP/1.1 201 Created\r\n"},
+                  {status::ACCEPTED, "HTTP/1.1 202 Accepted\r\n"},
+                  {status::NON_AUTHORITATIVE_INFORMATION, "HTTP/1.1 203 Non-Authoritative Information\r\n"},
+                  {status::NO_CONTENT, "HTTP/1.1 204 No Content\r\n"},
+                  {status::RESET_CONTENT, "HTTP/1.1 205 Reset Content\r\n"},
+                  {status::PARTIAL_CONTENT, "HTTP/1.1 206 Partial Content\r\n"},
+                  {status::WEBDAV_MULTI_STATUS, "HTTP/1.1 207 Multi-Status\r\n"},
+                  {status::MULTIPLE_CHOICES, "HTTP/1.1 300 Multiple Choices\r\n"},
+                  {status::MOVED_PERMANENTLY, "HTTP/1.1 301 Moved Permanently\r\n"},
+                  {status::FOUND, "HTTP/1.1 302 Found\r\n"},
+                  {status::SEE_OTHER, "HTTP/1.1 303 See Other\r\n"},
+                  {status::NOT_MODIFIED, "HTTP/1.1 304 Not Modified\r\n"},
+                  {status::TEMPORARY_REDIRECT, "HTTP/1.1 307 Temporary Redirect\r\n"},
+                  {status::PERMANENT_REDIRECT, "HTTP/1.1 308 Permanent Redirect\r\n"},
+                  {status::BAD_REQUEST, "HTTP/1.1 400 Bad Request\r\n"},
+                  {status::UNAUTHORIZED, "HTTP/1.1 401 Unauthorized\r\n"},
+                  {status::FORBIDDEN, "HTTP/1.1 403 Forbidden\r\n"},
+                  {status::NOT_FOUND, "HTTP/1.1 404 Not Found\r\n"},
+                  {status::METHOD_NOT_ALLOWED, "HTTP/1.1 405 Method Not Allowed\r\n"},
+                  {status::NOT_ACCEPTABLE, "HTTP/1.1 406 Not Acceptable\r\n"},
+                  {status::PROXY_AUTHENTICATION_REQUIRED, "HTTP/1.1 407 Proxy Authentication Required\r\n"},
+                  {status::CONFLICT, "HTTP/1.1 409 Conflict\r\n"},
+                  {status::GONE, "HTTP/1.1 410 Gone\r\n"},
+                  {status::PAYLOAD_TOO_LARGE, "HTTP/1.1 413 Payload Too Large\r\n"},
+                  {status::UNSUPPORTED_MEDIA_TYPE, "HTTP/1.1 415 Unsupported Media Type\r\n"},
+                  {status::RANGE_NOT_SATISFIABLE, "HTTP/1.1 416 Range Not Satisfiable\r\n"},
+                  {status::EXPECTATION_FAILED, "HTTP/1.1 417 Expectation Failed\r\n"},
+                  {status::WEBDAV_PRECONDITION_FAILED, "HTTP/1.1 412 Precondition Failed\r\n"},
+                  {status::WEBDAV_REQUEST_URI_TOO_LONG, "HTTP/1.1 414 Request-URI Too Long\r\n"},
+                  {status::WEBDAV_UNPROCESSABLE_ENTITY, "HTTP/1.1 422 Unprocessable Entity\r\n"},
+                  {status::WEBDAV_LOCKED, "HTTP/1.1 423 Locked\r\n"},
+                  {status::WEBDAV_FAILED_DEPENDENCY, "HTTP/1.1 424 Failed Dependency\r\n"},
+                  {status::PRECONDITION_REQUIRED, "HTTP/1.1 428 Precondition Required\r\n"},
+                  {status::TOO_MANY_REQUESTS, "HTTP/1.1 429 Too Many Requests\r\n"},
+                  {status::UNAVAILABLE_FOR_LEGAL_REASONS, "HTTP/1.1 451 Unavailable For Legal Reasons\r\n"},
+                  {status::INTERNAL_SERVER_ERROR, "HTTP/1.1 500 Internal Server Error\r\n"},
+                  {status::NOT_IMPLEMENTED, "HTTP/1.1 501 Not Implemented\r\n"},
+                  {status::BAD_GATEWAY, "HTTP/1.1 502 Bad Gateway\r\n"},
+                  {status::SERVICE_UNAVAILABLE, "HTTP/1.1 503 Service Unavailable\r\n"},
+                  {status::GATEWAY_TIMEOUT, "HTTP/1.1 504 Gateway Timeout\r\n"},
+                  {status::VARIANT_ALSO_NEGOTIATES, "HTTP/1.1 506 Variant Also Negotiates\r\n"},
+                  {status::WEBDAV_INSUFFICIENT_STORAGE, "HTTP/1.1 507 Insufficient Storage\r\n"},
+                };
+                for (auto& line : known)
+                    table[line.first] = line.second;
+                return table;
+            }();
+            return code >= 0 && code < static_cast<int>(lines.size()) ? lines[code] : std::string_view();
+        }
+    } // namespace detail
+
+    /// The body of a response which is sent while it's being produced, see \ref response::stream().
+
+    ///
+    /// All methods can be called from any thread. Destroying the stream ends the response.
+    class response_stream
+    {
+    public:
+        response_stream() = default;
+        response_stream(const response_stream&) = delete;
+        response_stream& operator=(const response_stream&) = delete;
+
+        ~response_stream()
+        {
+            end();
+        }
+
+        /// Send the next part of the body.
+
+        ///
+        /// `on_written` is called on the connection's thread once the data was handed to the socket, or with `false` if it can't be sent (e.g. because the client left).
+        /// Producing the next part only after that keeps memory use bounded, no matter how slow the client reads.
+        void write(std::string data, std::function<void(bool)> on_written = nullptr)
+        {
+            if (!attached_)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!attached_ && !ended_)
+                {
+                    // The connection picks the stream up once the handler has returned, the data is sent then
+                    pending_.push_back({std::move(data), std::move(on_written)});
+                    return;
+                }
+            }
+            // The handlers don't change once the stream is attached
+            if (write_handler_ && !ended_)
+                write_handler_(std::move(data), std::move(on_written));
+            else if (on_written)
+                on_written(false);
+        }
+
+        /// Finish the response, after every part written before has been sent.
+        void end()
+        {
+            bool attached;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                bool ended = false;
+                if (!ended_.compare_exchange_strong(ended, true))
+                    return;
+                attached = attached_;
+            }
+            // Otherwise the response is ended when the stream is attached
+            if (attached && end_handler_)
+                end_handler_();
+        }
+
+        /// Whether data can still be sent (the stream wasn't ended and the connection is alive).
+        bool is_open() const
+        {
+            return open_ && !ended_;
+        }
+
+    private:
+        template<typename Adaptor, typename Handler, typename... Middlewares>
+        friend class crow::Connection;
+
+        using write_handler = std::function<void(std::string, std::function<void(bool)>)>;
+
+        /// Bind the stream to its connection, on the connection's thread. Empty handlers make all writes fail.
+        void attach(write_handler on_write, std::function<void()> on_end)
+        {
+            std::vector<std::pair<std::string, std::function<void(bool)>>> pending;
+            bool ended;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                write_handler_ = std::move(on_write);
+                end_handler_ = std::move(on_end);
+                pending.swap(pending_);
+                ended = ended_;
+                attached_ = true;
+            }
+            // Other threads' writes are dispatched to this thread, so they come after these
+            for (auto& write : pending)
+            {
+                if (write_handler_)
+                    write_handler_(std::move(write.first), std::move(write.second));
+                else if (write.second)
+                    write.second(false);
+            }
+            if (ended && end_handler_)
+                end_handler_();
+        }
+
+        std::mutex mutex_; ///< Guards the handlers and `pending_` until the stream is attached.
+        write_handler write_handler_;
+        std::function<void()> end_handler_;
+        std::vector<std::pair<std::string, std::function<void(bool)>>> pending_; ///< Written before the stream was attached.
+        std::atomic<bool> attached_{false};
+        std::atomic<bool> open_{false};
+        std::atomic<bool> ended_{false};
+    };
+
     /// HTTP response
     struct response
     {
@@ -183,6 +384,7 @@ namespace crow
             headers = std::move(r.headers);
             completed_ = r.completed_;
             file_info = std::move(r.file_info);
+            stream_ = std::move(r.stream_);
             return *this;
         }
 
@@ -199,6 +401,7 @@ namespace crow
             headers.clear();
             completed_ = false;
             file_info = static_file_info{};
+            stream_.reset();
         }
 
         /// Return a "Temporary Redirect" response.
@@ -254,19 +457,41 @@ namespace crow
                 completed_ = true;
                 if (skip_body)
                 {
-                    set_header("Content-Length", std::to_string(body.size()));
+                    if (!is_static_type())
+                        set_header("Content-Length", std::to_string(body.size()));
                     body = "";
                     manual_length_header = true;
                 }
                 if (complete_request_handler_)
                 {
-                    complete_request_handler_();
+                    // The handler keeps the connection (and this response) alive until it's done with, even if the response is sent from another thread meanwhile
+                    auto complete_request_handler = std::move(complete_request_handler_);
+                    complete_request_handler();
                     manual_length_header = false;
                     skip_body = false;
                 }
             }
         }
 
+        /// Send the body while it's being produced instead of all at once, using chunked transfer encoding.
+
+        ///
+        /// The status and headers are sent right away (this ends the response like end() does), the body is then written through the returned stream.
+        /// Clients speaking HTTP/1.0 get the body without chunk framing, and the connection is closed after it.
+        std::shared_ptr<response_stream> stream()
+        {
+            auto stream = std::make_shared<response_stream>();
+            stream_ = stream;
+            end();
+            return stream;
+        }
+
+        /// Check whether the body is sent through a \ref response_stream.
+        bool is_streaming() const
+        {
+            return static_cast<bool>(stream_);
+        }
+
         /// Same as end() except it adds a body part right before ending.
         void end(const std::string& body_part)
         {
@@ -295,6 +520,17 @@ namespace crow
             std::string path = "";
             struct stat statbuf;
             int statResult;
+            std::shared_ptr<const detail::static_file_entry> cached; ///< Precomputed details and the open file, if the cache is enabled.
+
+            /// A part of the file to send, preceded by `part_header` (used by `multipart/byteranges` responses).
+            struct byte_range
+            {
+                uint64_t offset;
+                uint64_t length;
+                std::string part_header;
+            };
+            std::vector<byte_range> ranges; ///< The parts of the file to send, the whole file if empty.
+            std::string ranges_trailer;     ///< Sent after the last range (the closing `multipart/byteranges` boundary).
         };
 
         /// Return a static file as the response body, the content_type may be specified explicitly.
@@ -308,24 +544,36 @@ namespace crow
         /// the content_type may be specified explicitly.
         void set_static_file_info_unsafe(std::string path, std::string content_type = "")
         {
+            auto entry = detail::static_file_cache::local().get(path);
             file_info.path = path;
-            file_info.statResult = stat(file_info.path.c_str(), &file_info.statbuf);
+            file_info.statbuf = entry->statbuf;
+            file_info.statResult = entry->stat_result;
 #ifdef CROW_ENABLE_COMPRESSION
             compressed = false;
 #endif
-            if (file_info.statResult == 0 && S_ISREG(file_info.statbuf.st_mode))
+            if (entry->is_regular_file())
             {
                 code = 200;
-                this->add_header("Content-Length", std::to_string(file_info.statbuf.st_size));
+                file_info.cached = std::move(entry);
+                this->add_header("Content-Length", file_info.cached->content_length);
+                this->add_header("Last-Modified", file_info.cached->last_modified);
+                this->add_header("ETag", file_info.cached->etag);
 
                 if (content_type.empty())
                 {
-                    std::size_t last_dot = path.find_last_of('.');
-                    std::string extension = path.substr(last_dot + 1);
-
-                    if (!extension.empty())
+                    if (!file_info.cached->content_type.empty())
                     {
-                        this->add_header("Content-Type", get_mime_type(extension));
+                        this->add_header("Content-Type", file_info.cached->content_type);
+                    }
+                    else
+                    {
+                        std::size_t last_dot = path.find_last_of('.');
+                        std::string extension = path.substr(last_dot + 1);
+
+                        if (!extension.empty())
+                        {
+                            this->add_header("Content-Type", get_mime_type(extension));
+                        }
                     }
                 }
                 else
@@ -340,125 +588,305 @@ namespace crow
             }
         }
 
-    private:
-        void write_header_into_buffer(std::vector<asio::const_buffer>& buffers, std::string& content_length_buffer, bool add_keep_alive, const std::string& server_name)
-        {
-            // TODO(EDev): HTTP version in status codes should be dynamic
-            // Keep in sync with common.h/status
-            static std::unordered_map<int, std::string> statusCodes = {
-              {status::CONTINUE, "HTTP/1.1 100 Continue\r\n"},
-              {status::SWITCHING_PROTOCOLS, "HTTP/1.1 101 Switching Protocols\r\n"},
-
-              {status::OK, "HTTP/1.1 200 OK\r\n"},
-              {status::CREATED, "HTTP/1.1 201 Created\r\n"},
-              {status::ACCEPTED, "HTTP/1.1 202 Accepted\r\n"},
-              {status::NON_AUTHORITATIVE_INFORMATION, "HTTP/1.1 203 Non-Authoritative Information\r\n"},
-              {status::NO_CONTENT, "HTTP/1.1 204 No Content\r\n"},
-              {status::RESET_CONTENT, "HTTP/1.1 205 Reset Content\r\n"},
-              {status::PARTIAL_CONTENT, "HTTP/1.1 206 Partial Content\r\n"},
-              {status::WEBDAV_MULTI_STATUS, "HTTP/1.1 207 Multi-Status\r\n"},
-              {status::MULTIPLE_CHOICES, "HTTP/1.1 300 Multiple Choices\r\n"},
-              {status::MOVED_PERMANENTLY, "HTTP/1.1 301 Moved Permanently\r\n"},
-              {status::FOUND, "HTTP/1.1 302 Found\r\n"},
-              {status::SEE_OTHER, "HTTP/1.1 303 See Other\r\n"},
-              {status::NOT_MODIFIED, "HTTP/1.1 304 Not Modified\r\n"},
-              {status::TEMPORARY_REDIRECT, "HTTP/1.1 307 Temporary Redirect\r\n"},
-              {status::PERMANENT_REDIRECT, "HTTP/1.1 308 Permanent Redirect\r\n"},
-
-              {status::BAD_REQUEST, "HTTP/1.1 400 Bad Request\r\n"},
-              {status::UNAUTHORIZED, "HTTP/1.1 401 Unauthorized\r\n"},
-              {status::FORBIDDEN, "HTTP/1.1 403 Forbidden\r\n"},
-              {status::NOT_FOUND, "HTTP/1.1 404 Not Found\r\n"},
-              {status::METHOD_NOT_ALLOWED, "HTTP/1.1 405 Method Not Allowed\r\n"},
-              {status::NOT_ACCEPTABLE, "HTTP/1.1 406 Not Acceptable\r\n"},
-              {status::PROXY_AUTHENTICATION_REQUIRED, "HTTP/1.1 407 Proxy Authentication Required\r\n"},
-              {status::CONFLICT, "HTTP/1.1 409 Conflict\r\n"},
-              {status::GONE, "HTTP/1.1 410 Gone\r\n"},
-              {status::PAYLOAD_TOO_LARGE, "HTTP/1.1 413 Payload Too Large\r\n"},
-              {status::UNSUPPORTED_MEDIA_TYPE, "HTTP/1.1 415 Unsupported Media Type\r\n"},
-              {status::RANGE_NOT_SATISFIABLE, "HTTP/1.1 416 Range Not Satisfiable\r\n"},
-              {status::EXPECTATION_FAILED, "HTTP/1.1 417 Expectation Failed\r\n"},
-              {status::WEBDAV_PRECONDITION_FAILED, "HTTP/1.1 412 Precondition Failed\r\n"},
-              {status::WEBDAV_REQUEST_URI_TOO_LONG, "HTTP/1.1 414 Request-URI Too Long\r\n"},
-              {status::WEBDAV_UNPROCESSABLE_ENTITY, "HTTP/1.1 422 Unprocessable Entity\r\n"},
-              {status::WEBDAV_LOCKED, "HTTP/1.1 423 Locked\r\n"},
-              {status::WEBDAV_FAILED_DEPENDENCY, "HTTP/1.1 424 Failed Dependency\r\n"},
-              {status::PRECONDITION_REQUIRED, "HTTP/1.1 428 Precondition Required\r\n"},
-              {status::TOO_MANY_REQUESTS, "HTTP/1.1 429 Too Many Requests\r\n"},
-              {status::UNAVAILABLE_FOR_LEGAL_REASONS, "HTTP/1.1 451 Unavailable For Legal Reasons\r\n"},
-
-              {status::INTERNAL_SERVER_ERROR, "HTTP/1.1 500 Internal Server Error\r\n"},
-              {status::NOT_IMPLEMENTED, "HTTP/1.1 501 Not Implemented\r\n"},
-              {status::BAD_GATEWAY, "HTTP/1.1 502 Bad Gateway\r\n"},
-              {status::SERVICE_UNAVAILABLE, "HTTP/1.1 503 Service Unavailable\r\n"},
-              {status::GATEWAY_TIMEOUT, "HTTP/1.1 504 Gateway Timeout\r\n"},
-              {status::VARIANT_ALSO_NEGOTIATES, "HTTP/1.1 506 Variant Also Negotiates\r\n"},
-              {status::WEBDAV_INSUFFICIENT_STORAGE,  "HTTP/1.1 507 Insufficient Storage\r\n"},
-              };
-
-            static const std::string seperator = ": ";
+        /// Serialize the status line and headers into `header_block`, and point `buffers` at it.
 
-            buffers.clear();
-            buffers.reserve(4 * (headers.size() + 5) + 3);
-
-            if (!statusCodes.count(code))
+        ///
+        /// `server_header` is a whole `Server` header line (empty for none). `date_line` (see \ref detail::date_header) ends the headers and is referenced rather than copied.
+        void write_header_into_buffer(std::vector<asio::const_buffer>& buffers, std::string& header_block, bool add_keep_alive, const std::string& server_header, const std::string* date_line = nullptr)
+        {
+            std::string_view status = detail::status_line(code);
+            if (status.empty())
             {
                 CROW_LOG_WARNING << this << " status code "
                                  << "(" << code << ")"
                                  << " not defined, returning 500 instead";
                 code = 500;
+                status = detail::status_line(code);
             }
 
-            auto& status = statusCodes.find(code)->second;
-            buffers.emplace_back(status.data(), status.size());
-
             if (code >= 400 && body.empty())
-                body = statusCodes[code].substr(9);
+                body = std::string(status.substr(9));
 
+            header_block.clear(); // Keeps its capacity for the next response
+            header_block.append(status.data(), status.size());
+            // Looking the headers the server may add up in the map would hash their names, they're spotted on the way instead
+            bool has_length = false, has_server = false, has_date = false;
             for (auto& kv : headers)
             {
-                buffers.emplace_back(kv.first.data(), kv.first.size());
-                buffers.emplace_back(seperator.data(), seperator.size());
-                buffers.emplace_back(kv.second.data(), kv.second.size());
-                buffers.emplace_back(crlf.data(), crlf.size());
+                switch (kv.first.size())
+                {
+                    case 4: has_date = has_date || utility::string_equals(kv.first, "date"); break;
+                    case 6: has_server = has_server || utility::string_equals(kv.first, "server"); break;
+                    case 14: has_length = has_length || utility::string_equals(kv.first, "content-length"); break;
+                }
+                header_block.append(kv.first).append(": ", 2).append(kv.second).append("\r\n", 2);
             }
 
-            if (!manual_length_header && !headers.count("content-length"))
+            if (!manual_length_header && !has_length)
             {
-                content_length_buffer = std::to_string(body.size());
-                static std::string content_length_tag = "Content-Length: ";
-                buffers.emplace_back(content_length_tag.data(), content_length_tag.size());
-                buffers.emplace_back(content_length_buffer.data(), content_length_buffer.size());
-                buffers.emplace_back(crlf.data(), crlf.size());
+                char length[24];
+                auto end = std::to_chars(length, length + sizeof(length), body.size()).ptr;
+                header_block.append("Content-Length: ", 16).append(length, end - length).append("\r\n", 2);
             }
-            if (!headers.count("server") && !server_name.empty())
+            if (!server_header.empty() && !has_server)
             {
-                static std::string server_tag = "Server: ";
-                buffers.emplace_back(server_tag.data(), server_tag.size());
-                buffers.emplace_back(server_name.data(), server_name.size());
-                buffers.emplace_back(crlf.data(), crlf.size());
+                header_block.append(server_header);
             }
-            /*if (!headers.count("date"))
-            {
-                static std::string date_tag = "Date: ";
-                date_str_ = get_cached_date_str();
-                buffers.emplace_back(date_tag.data(), date_tag.size());
-                buffers.emplace_back(date_str_.data(), date_str_.size());
-                buffers.emplace_back(crlf.data(), crlf.size());
-            }*/
             if (add_keep_alive)
             {
-                static std::string keep_alive_tag = "Connection: Keep-Alive";
-                buffers.emplace_back(keep_alive_tag.data(), keep_alive_tag.size());
-                buffers.emplace_back(crlf.data(), crlf.size());
+                header_block.append("Connection: Keep-Alive\r\n", 24);
+            }
+
+            buffers.clear();
+            if (date_line && !has_date)
+            {
+                buffers.emplace_back(header_block.data(), header_block.size());
+                buffers.emplace_back(date_line->data(), date_line->size());
+            }
+            else
+            {
+                header_block.append("\r\n", 2);
+                buffers.emplace_back(header_block.data(), header_block.size());
+            }
+        }
+
+    private:
+        /// Add a request header to the `Vary` header, unless it is listed already.
+        void add_vary_header(const std::string& field)
+        {
+            const std::string& vary = get_header_value("Vary");
+            if (vary.empty())
+                set_header("Vary", field);
+            else if (vary.find(field) == std::string::npos)
+                set_header("Vary", vary + ", " + field);
+        }
+
+        /// Switch the static file to a precompressed sibling (`file.br`, `file.zst` or `file.gz`) the client accepts, if there is one.
+
+        ///
+        /// The sibling is sent as it is with a matching `Content-Encoding`, no compression happens while the request is served.
+        void select_precompressed_static_file(const request& req)
+        {
+            static const std::array<std::pair<const char*, const char*>, 3> encodings = {{
+              {"br", ".br"},
+              {"zstd", ".zst"},
+              {"gzip", ".gz"},
+            }};
+
+            if (code != 200 || file_info.statResult != 0 || headers.count("Content-Encoding"))
+                return;
+            add_vary_header("Accept-Encoding");
+
+            const std::string& accept_encoding = req.get_header_value("Accept-Encoding");
+            if (accept_encoding.empty())
+                return;
+
+            // Highest quality wins, ties go to the encoding listed first (the smallest output)
+            std::shared_ptr<const detail::static_file_entry> best;
+            const std::pair<const char*, const char*>* best_encoding = nullptr;
+            float best_quality = 0;
+            for (const auto& encoding : encodings)
+            {
+                float quality = utility::header_token_quality(accept_encoding, encoding.first);
+                if (quality <= best_quality)
+                    continue;
+                auto entry = detail::static_file_cache::local().get(file_info.path + encoding.second);
+                if (!entry->is_regular_file())
+                    continue;
+                best = std::move(entry);
+                best_encoding = &encoding;
+                best_quality = quality;
+            }
+            if (!best)
+                return;
+
+            file_info.path += best_encoding->second;
+            file_info.statbuf = best->statbuf;
+            file_info.statResult = best->stat_result;
+            set_header("Content-Encoding", best_encoding->first);
+            set_header("Content-Length", best->content_length);
+            set_header("Last-Modified", best->last_modified);
+            set_header("ETag", best->etag);
+            file_info.cached = std::move(best);
+        }
+
+        /// Answer the conditional (`If-None-Match`, `If-Modified-Since`) and `Range` headers of a request for a static file.
+
+        ///
+        /// This turns the response into a `304 Not Modified`, a `206 Partial Content` or a `416 Range Not Satisfiable` as needed.
+        /// It only looks at the headers and metadata gathered by \ref set_static_file_info, the file itself isn't touched.
+        void evaluate_static_file_request(const request& req)
+        {
+            if (code != 200 || file_info.statResult != 0 || (req.method != HTTPMethod::Get && req.method != HTTPMethod::Head))
+                return;
+            set_header("Accept-Ranges", "bytes");
+
+            const std::string& etag = get_header_value("ETag");
+            const std::string& if_none_match = req.get_header_value("If-None-Match");
+            bool not_modified;
+            if (!if_none_match.empty())
+            {
+                not_modified = etag_list_matches(if_none_match, etag);
+            }
+            else
+            {
+                int64_t since;
+                not_modified = utility::parse_http_date(req.get_header_value("If-Modified-Since"), since) &&
+                               static_cast<int64_t>(file_info.statbuf.st_mtime) <= since;
+            }
+            if (not_modified)
+            {
+                // Content-Length stays, it describes the representation the client already has
+                code = 304;
+                headers.erase("Content-Type");
+                headers.erase("Accept-Ranges");
+                file_info.path.clear();
+                return;
+            }
+
+            const std::string& range = req.get_header_value("Range");
+            if (req.method != HTTPMethod::Get || range.empty())
+                return;
+
+            // A range of an outdated representation would be garbage, send the whole file instead
+            const std::string& if_range = req.get_header_value("If-Range");
+            if (!if_range.empty())
+            {
+                bool is_etag = if_range.front() == '"' || if_range.compare(0, 2, "W/") == 0;
+                if (is_etag ? (if_range != etag || etag.compare(0, 2, "W/") == 0) : if_range != get_header_value("Last-Modified"))
+                    return;
+            }
+
+            const uint64_t size = static_cast<uint64_t>(file_info.statbuf.st_size);
+            std::vector<std::pair<uint64_t, uint64_t>> satisfiable; // first and last byte
+            if (!parse_byte_ranges(range, size, satisfiable))
+                return;
+
+            if (satisfiable.empty())
+            {
+                code = 416;
+                headers.erase("Content-Length");
+                headers.erase("Content-Type");
+                set_header("Content-Range", "bytes */" + std::to_string(size));
+                file_info.path.clear();
+                return;
+            }
+
+            code = 206;
+            if (satisfiable.size() == 1)
+            {
+                const auto& r = satisfiable.front();
+                set_header("Content-Range", "bytes " + std::to_string(r.first) + '-' + std::to_string(r.second) + '/' + std::to_string(size));
+                set_header("Content-Length", std::to_string(r.second - r.first + 1));
+                file_info.ranges.push_back({r.first, r.second - r.first + 1, {}});
+                return;
+            }
+
+            const std::string boundary = utility::random_alphanum(24);
+            const std::string part_type = get_header_value("Content-Type");
+            uint64_t content_length = 0;
+            for (const auto& r : satisfiable)
+            {
+                std::string part_header = "\r\n--" + boundary + "\r\n";
+                if (!part_type.empty())
+                    part_header += "Content-Type: " + part_type + "\r\n";
+                part_header += "Content-Range: bytes " + std::to_string(r.first) + '-' + std::to_string(r.second) + '/' + std::to_string(size) + "\r\n\r\n";
+                content_length += part_header.size() + r.second - r.first + 1;
+                file_info.ranges.push_back({r.first, r.second - r.first + 1, std::move(part_header)});
+            }
+            file_info.ranges_trailer = "\r\n--" + boundary + "--\r\n";
+            content_length += file_info.ranges_trailer.size();
+
+            set_header("Content-Type", "multipart/byteranges; boundary=" + boundary);
+            set_header("Content-Length", std::to_string(content_length));
+        }
+
+        /// Weak comparison of an entity tag against an `If-None-Match` list.
+        static bool etag_list_matches(const std::string& list, const std::string& etag)
+        {
+            if (etag.empty())
+                return false;
+            auto opaque = [](std::string_view tag) {
+                return tag.substr(0, 2) == "W/" ? tag.substr(2) : tag;
+            };
+            for (const auto& candidate : utility::split(list, ","))
+            {
+                std::string_view tag = utility::trim(candidate);
+                if (tag == "*" || opaque(tag) == opaque(etag))
+                    return true;
             }
+            return false;
+        }
+
+        /// Parse a `Range: bytes=...` header into the satisfiable ranges of a file with `size` bytes.
+
+        ///
+        /// Returns false if the header is malformed or asks for too many ranges, in which case it should be ignored.
+        static bool parse_byte_ranges(const std::string& value, uint64_t size, std::vector<std::pair<uint64_t, uint64_t>>& ranges)
+        {
+            static constexpr size_t max_ranges = 64;
+            if (value.size() < 6 || !utility::string_equals(std::string_view(value).substr(0, 6), "bytes="))
+                return false;
+
+            auto number = [](std::string_view digits, uint64_t& result) {
+                if (digits.empty() || digits.size() > 18)
+                    return false;
+                result = 0;
+                for (char c : digits)
+                {
+                    if (c < '0' || c > '9')
+                        return false;
+                    result = result * 10 + static_cast<uint64_t>(c - '0');
+                }
+                return true;
+            };
 
-            buffers.emplace_back(crlf.data(), crlf.size());
+            size_t count = 0;
+            for (const auto& element : utility::split(value.substr(6), ","))
+            {
+                std::string_view spec = utility::trim(element);
+                if (spec.empty())
+                    continue;
+                if (++count > max_ranges)
+                    return false;
+
+                size_t dash = spec.find('-');
+                if (dash == std::string_view::npos)
+                    return false;
+                uint64_t first, last;
+                if (dash == 0)
+                {
+                    // Suffix range: the last N bytes
+                    uint64_t suffix;
+                    if (!number(spec.substr(1), suffix))
+                        return false;
+                    if (suffix == 0 || size == 0)
+                        continue;
+                    first = suffix < size ? size - suffix : 0;
+                    last = size - 1;
+                }
+                else
+                {
+                    if (!number(spec.substr(0, dash), first))
+                        return false;
+                    if (dash + 1 == spec.size())
+                        last = size - 1;
+                    else if (!number(spec.substr(dash + 1), last) || last < first)
+                        return false;
+                    if (first >= size)
+                        continue;
+                    last = std::min(last, size - 1);
+                }
+                ranges.emplace_back(first, last);
+            }
+            return count > 0;
         }
 
+
         bool completed_{};
         std::function<void()> complete_request_handler_;
         std::function<bool()> is_alive_helper_;
         static_file_info file_info;
+        std::shared_ptr<response_stream> stream_; ///< Handed over to the connection when the response is sent.
     };
 } // namespace crow
@@ -18,16 +18,23 @@
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <future>
 #include <memory>
 #include <thread>
 #include <vector>
 
 #include "crow/version.h"
+#include "crow/admission_control.h"
+#include "crow/connection_pool.h"
+#include "crow/cpu_affinity.h"
 #include "crow/http_connection.h"
+#include "crow/load_balancing.h"
 #include "crow/logging.h"
 #include "crow/task_timer.h"
 #include "crow/socket_acceptors.h"
+#include "crow/socket_handoff.h"
+#include "crow/static_file_cache.h"
 #include "crow/tcp_socket_options.h"
 
 
@@ -53,26 +60,59 @@ namespace crow // NOTE: Already documented in "crow/app.h"
              unsigned int concurrency = 1,
              uint8_t timeout = 5,
              typename Adaptor::context* adaptor_ctx = nullptr,
-             detail::socket::tcp_socket_options tcp_socket_options = {}):
+             detail::socket::tcp_socket_options tcp_socket_options = {},
+             bool reuse_port = false,
+             int listen_fd = -1):
           concurrency_(concurrency),
-          task_queue_length_pool_(concurrency_ - 1),
+          worker_load_pool_(concurrency_ - 1),
+          connection_lists_(concurrency_ - 1),
+          admission_(worker_load_pool_),
+          connection_pools_(concurrency_ - 1),
+          read_buffer_pools_(concurrency_ - 1),
           acceptor_(io_context_),
           signals_(io_context_),
           tick_timer_(io_context_),
+          drain_timer_(io_context_),
+          handoff_acceptor_(io_context_),
           handler_(handler),
           timeout_(timeout),
           server_name_(server_name),
+          server_header_(server_name.empty() ? std::string() : "Server: " + server_name + "\r\n"),
           middlewares_(middlewares),
           adaptor_ctx_(adaptor_ctx),
-          tcp_socket_options_(tcp_socket_options)
+          tcp_socket_options_(tcp_socket_options),
+          reuse_port_(reuse_port)
         {
             if (startup_failed_) {
                 CROW_LOG_ERROR << "Startup failed; not running server.";
                 return;
             }
 
+            if (reuse_port_ && !Acceptor::supports_reuse_port)
+            {
+                CROW_LOG_WARNING << "SO_REUSEPORT is not supported for this socket type or platform, using a single acceptor.";
+                reuse_port_ = false;
+            }
+
             error_code ec;
 
+            if (listen_fd >= 0)
+            {
+                if (reuse_port_)
+                {
+                    CROW_LOG_WARNING << "SO_REUSEPORT can't be used with an inherited listening socket, using a single acceptor.";
+                    reuse_port_ = false;
+                }
+                acceptor_.assign(listen_fd, ec);
+                if (ec) {
+                    CROW_LOG_ERROR << "Failed to use inherited listening socket " << listen_fd << ": " << ec.message();
+                    startup_failed_ = true;
+                    return;
+                }
+                inherited_socket_ = true;
+                return;
+            }
+
             acceptor_.raw_acceptor().open(endpoint.protocol(), ec);
             if (ec) {
                 CROW_LOG_ERROR << "Failed to open acceptor: " << ec.message();
@@ -87,6 +127,19 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 return;
             }
 
+            if constexpr (Acceptor::supports_reuse_port)
+            {
+                if (reuse_port_)
+                {
+                    acceptor_.raw_acceptor().set_option(Acceptor::reuse_port_option(), ec);
+                    if (ec) {
+                        CROW_LOG_ERROR << "Failed to set SO_REUSEPORT: " << ec.message();
+                        startup_failed_ = true;
+                        return;
+                    }
+                }
+            }
+
             acceptor_.raw_acceptor().bind(endpoint, ec);
             if (ec) {
                 CROW_LOG_ERROR << "Failed to bind to " << acceptor_.address()
@@ -95,6 +148,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 return;
             }
 
+            // With SO_REUSEPORT this socket only holds on to the port, the workers listen on their own sockets
+            if (reuse_port_)
+                return;
+
             acceptor_.raw_acceptor().listen(tcp::acceptor::max_listen_connections, ec);
             if (ec) {
                 CROW_LOG_ERROR << "Failed to listen on port: " << ec.message();
@@ -111,6 +168,68 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             tick_function_ = f;
         }
 
+        /// Set how connections are spread between the workers (unused with `reuse_port`, where the kernel does it).
+        void set_load_balancing(load_balancing strategy)
+        {
+            load_balancer_.strategy(strategy);
+        }
+
+        /// Pin worker `i` to `worker_cpus[i % worker_cpus.size()]` and the thread accepting connections to `acceptor_cpu` (unless they're empty / negative).
+        void set_cpu_affinity(std::vector<int> worker_cpus, int acceptor_cpu)
+        {
+            worker_cpus_ = std::move(worker_cpus);
+            acceptor_cpu_ = acceptor_cpu;
+        }
+
+        /// Set the limits on connections and requests, over which they're turned away.
+        void set_admission_limits(const detail::admission_limits& limits)
+        {
+            admission_.limits(limits);
+        }
+
+        /// Connections and requests turned away so far, can be called from any thread.
+        crow::shed_stats shed_stats() const
+        {
+            return admission_.stats();
+        }
+
+        /// Keep the memory of up to `max_free` closed connections per worker for new ones, taking new memory from `allocator` (if set) instead of `operator new`.
+        void set_connection_pool(size_t max_free, crow::connection_allocator allocator)
+        {
+            connection_pool_size_ = max_free;
+            connection_allocator_ = std::move(allocator);
+        }
+
+        /// Cache up to `max_entries` static files per worker, each trusted for `ttl`, see \ref detail::static_file_cache.
+        void set_static_file_cache(size_t max_entries, std::chrono::milliseconds ttl)
+        {
+            static_file_cache_size_ = max_entries;
+            static_file_cache_ttl_ = ttl;
+        }
+
+        /// Call `f` instead of stopping when one of the signals arrives (a second signal still stops right away).
+        void set_signal_function(std::function<void()> f)
+        {
+            signal_function_ = std::move(f);
+        }
+
+        /// Give the listening socket to the next process connecting to the Unix socket at `path`, then call `f` (which should stop this server, e.g. by draining it).
+        void set_socket_handoff(std::string path, std::function<void()> f)
+        {
+            handoff_path_ = std::move(path);
+            handoff_function_ = std::move(f);
+        }
+
+        /// The current load of every worker thread, can be called from any thread.
+        std::vector<worker_load> worker_loads() const
+        {
+            std::vector<worker_load> loads;
+            loads.reserve(worker_load_pool_.size());
+            for (auto& load : worker_load_pool_)
+                loads.push_back(load.snapshot());
+            return loads;
+        }
+
         void on_tick()
         {
             tick_function_();
@@ -133,8 +252,21 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             uint16_t worker_thread_count = concurrency_ - 1;
             for (int i = 0; i < worker_thread_count; i++)
                 io_context_pool_.emplace_back(new asio::io_context());
-            get_cached_date_str_pool_.resize(worker_thread_count);
+            if (reuse_port_ && !open_worker_acceptors())
+            {
+                std::unique_lock<std::mutex> lock(start_mutex_);
+                startup_failed_ = true;
+                cv_started_.notify_all();
+                return;
+            }
+            for (uint16_t i = 0; i < worker_thread_count; i++)
+            {
+                connection_pools_[i].configure(connection_pool_size_, i, &connection_allocator_);
+                read_buffer_pools_[i].configure(connection_pool_size_);
+            }
+            date_header_pool_.resize(worker_thread_count);
             task_timer_pool_.resize(worker_thread_count);
+            worker_locations_.assign(worker_thread_count, {});
 
             std::vector<std::future<void>> v;
             std::atomic<int> init_count(0);
@@ -142,38 +274,22 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 v.push_back(
                   std::async(
                     std::launch::async, [this, i, &init_count] {
-                        // thread local date string get function
-                        auto last = std::chrono::steady_clock::now();
-
-                        std::string date_str;
-                        auto update_date_str = [&] {
-                            auto last_time_t = time(0);
-                            tm my_tm;
+                        // First of all, so that what the worker allocates is local to its CPU's NUMA node
+                        bool pinned = !worker_cpus_.empty() && detail::cpu::pin_current_thread(worker_cpu(i));
+                        int cpu, node;
+                        detail::cpu::current_location(cpu, node);
+                        worker_locations_[i] = detail::cpu::describe_location(cpu, node) + (pinned ? "" : " unpinned");
 
-#if defined(_MSC_VER) || defined(__MINGW32__)
-                            gmtime_s(&my_tm, &last_time_t);
-#else
-                            gmtime_r(&last_time_t, &my_tm);
-#endif
-                            date_str.resize(100);
-                            size_t date_str_sz = strftime(&date_str[0], 99, "%a, %d %b %Y %H:%M:%S GMT", &my_tm);
-                            date_str.resize(date_str_sz);
-                        };
-                        update_date_str();
-                        get_cached_date_str_pool_[i] = [&]() -> std::string {
-                            if (std::chrono::steady_clock::now() - last >= std::chrono::seconds(1))
-                            {
-                                last = std::chrono::steady_clock::now();
-                                update_date_str();
-                            }
-                            return date_str;
-                        };
+                        // thread local Date header
+                        detail::date_header date_header;
+                        date_header_pool_[i] = &date_header;
 
                         // initializing task timers
                         detail::task_timer task_timer(*io_context_pool_[i]);
                         task_timer.set_default_timeout(timeout_);
                         task_timer_pool_[i] = &task_timer;
-                        task_queue_length_pool_[i] = 0;
+                        detail::static_file_cache::local().configure(static_file_cache_size_, static_file_cache_ttl_);
+                        worker_load_pool_[i].reset();
 
                         init_count++;
                         while (1)
@@ -207,21 +323,64 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             handler_->address_is_bound();
             CROW_LOG_INFO << server_name_ 
                           << " server is running at " << acceptor_.url_display(handler_->ssl_used()) 
-                          << " using " << concurrency_ << " threads";
+                          << " using " << concurrency_ << " threads"
+                          << (reuse_port_ ? " (one SO_REUSEPORT acceptor per worker)" : "")
+                          << (inherited_socket_ ? " (inherited listening socket)" : "");
             CROW_LOG_INFO << "Call `app.loglevel(crow::LogLevel::Warning)` to hide Info level logs.";
 
             signals_.async_wait(
-              [&](const error_code& /*error*/, int /*signal_number*/) {
-                  stop();
+              [&](const error_code& error, int /*signal_number*/) {
+                  if (error || !signal_function_)
+                  {
+                      stop();
+                      return;
+                  }
+                  signal_function_();
+                  signals_.async_wait([&](const error_code& /*error*/, int /*signal_number*/) {
+                      stop();
+                  });
               });
 
             while (worker_thread_count != init_count)
                 std::this_thread::yield();
 
-            do_accept();
+            std::string worker_locations;
+            for (auto& location : worker_locations_)
+                worker_locations += (worker_locations.empty() ? "" : ", ") + location;
+            CROW_LOG_INFO << "Worker thread CPUs: " << worker_locations;
+
+            if (reuse_port_)
+            {
+                for (size_t i = 0; i < worker_acceptors_.size(); i++)
+                {
+                    asio::post(*io_context_pool_[i], [this, i] {
+                        do_worker_accept(i);
+                    });
+                }
+            }
+            else
+            {
+                // Connections are accepted once the socket is readable, until none is left
+                error_code ec;
+                acceptor_.raw_acceptor().non_blocking(true, ec);
+                if (ec)
+                {
+                    CROW_LOG_ERROR << "Failed to make the acceptor non-blocking: " << ec.message();
+                    stop();
+                }
+                do_accept();
+            }
+            if (!handoff_path_.empty())
+                serve_handoff();
 
             std::thread(
               [this] {
+                  if (acceptor_cpu_ >= 0 && detail::cpu::pin_current_thread(acceptor_cpu_))
+                  {
+                      int cpu, node;
+                      detail::cpu::current_location(cpu, node);
+                      CROW_LOG_INFO << "Acceptor thread pinned to CPU " << detail::cpu::describe_location(cpu, node);
+                  }
                   notify_start();
                   io_context_.run();
                   CROW_LOG_INFO << "Exiting.";
@@ -231,21 +390,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
         void stop()
         {
-            shutting_down_ = true; // Prevent the acceptor from taking new connections
-
-            // Explicitly close the acceptor
-            // else asio will throw an exception (linux only), when trying to start server again:
-            // what():  bind: Address already in use
-            if (acceptor_.raw_acceptor().is_open())
-            {
-                CROW_LOG_INFO << "Closing acceptor. " << &acceptor_;
-                error_code ec;
-                acceptor_.raw_acceptor().close(ec);
-                if (ec)
-                {
-                    CROW_LOG_WARNING << "Failed to close acceptor: " << ec.message();
-                }
-            }
+            close_acceptors(true);
 
             for (auto& io_context : io_context_pool_)
             {
@@ -260,7 +405,39 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             io_context_.stop(); // Close main io_service
         }
 
-        
+        /// Stop accepting connections and let the open ones close after their current response, then stop.
+
+        ///
+        /// `done` is polled on the main thread, the server stops once it returns true or at `deadline`.
+        void drain(std::chrono::steady_clock::time_point deadline, std::function<bool()> done)
+        {
+            asio::post(io_context_, [this, deadline, done] {
+                if (draining_)
+                    return;
+                draining_ = true;
+                close_acceptors(false);
+                for (size_t i = 0; i < io_context_pool_.size(); i++)
+                {
+                    asio::post(*io_context_pool_[i], [this, i] {
+                        connection_lists_[i].for_each<Connection<Adaptor, Handler, Middlewares...>>([](Connection<Adaptor, Handler, Middlewares...>& connection) {
+                            connection.drain();
+                        });
+                    });
+                }
+                CROW_LOG_INFO << "Draining " << connection_count() << " connections";
+                wait_for_drain(deadline, done);
+            });
+        }
+
+        /// Open connections on all workers.
+        size_t connection_count() const
+        {
+            size_t count = 0;
+            for (auto& load : worker_load_pool_)
+                count += load.connections;
+            return count;
+        }
+
         uint16_t port() const {
             return acceptor_.local_endpoint().port();
         }
@@ -288,50 +465,326 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 
     private:
-        size_t pick_io_context_idx()
+        /// Prevent the acceptors from taking new connections, with `wait` the port is free once this returns.
+        void close_acceptors(bool wait)
         {
-            size_t min_queue_idx = 0;
+            shutting_down_ = true;
 
-            // TODO improve load balancing
-            // size_t is used here to avoid the security issue https://codeql.github.com/codeql-query-help/cpp/cpp-comparison-with-wider-type/
-            // even though the max value of this can be only uint16_t as concurrency is uint16_t.
-            for (size_t i = 1; i < task_queue_length_pool_.size() && task_queue_length_pool_[min_queue_idx] > 0; i++)
-            // No need to check other io_services if the current one has no tasks
+            // Explicitly close the acceptor
+            // else asio will throw an exception (linux only), when trying to start server again:
+            // what():  bind: Address already in use
+            if (acceptor_.raw_acceptor().is_open())
             {
-                if (task_queue_length_pool_[i] < task_queue_length_pool_[min_queue_idx])
-                    min_queue_idx = i;
+                CROW_LOG_INFO << "Closing acceptor. " << &acceptor_;
+                error_code ec;
+                acceptor_.raw_acceptor().close(ec);
+                if (ec)
+                {
+                    CROW_LOG_WARNING << "Failed to close acceptor: " << ec.message();
+                }
             }
-            return min_queue_idx;
+            for (size_t i = 0; i < worker_acceptors_.size(); i++)
+                close_worker_acceptor(i, wait);
+            if (handoff_acceptor_.is_open())
+            {
+                error_code ec;
+                handoff_acceptor_.close(ec);
+                // Once handed off, the path belongs to the next process
+                if (!handed_off_)
+                    std::remove(handoff_path_.c_str());
+            }
+        }
+
+        /// Listen on \ref handoff_path_ for the process taking over from this one.
+        void serve_handoff()
+        {
+            if constexpr (detail::handoff::supported)
+            {
+                if (reuse_port_)
+                {
+                    CROW_LOG_WARNING << "Socket handoff isn't supported together with SO_REUSEPORT";
+                    return;
+                }
+                // Either left behind by a process that didn't stop properly, or the socket of the process this one took over from
+                std::remove(handoff_path_.c_str());
+                error_code ec;
+                stream_protocol::endpoint endpoint(handoff_path_);
+                handoff_acceptor_.open(endpoint.protocol(), ec);
+                if (!ec)
+                    handoff_acceptor_.bind(endpoint, ec);
+                if (!ec)
+                    handoff_acceptor_.listen(1, ec);
+                if (ec)
+                {
+                    CROW_LOG_ERROR << "Failed to serve socket handoff on " << handoff_path_ << ": " << ec.message();
+                    handoff_acceptor_.close(ec);
+                    return;
+                }
+                do_handoff_accept();
+            }
+            else
+            {
+                CROW_LOG_WARNING << "Socket handoff is not supported on this platform";
+            }
+        }
+
+        /// Close the acceptor of `worker` on the worker's thread, which has a wait pending on it.
+        void close_worker_acceptor(size_t worker, bool wait)
+        {
+            auto& context = *io_context_pool_[worker];
+            auto close = [this, worker] {
+                error_code ec;
+                worker_acceptors_[worker]->raw_acceptor().close(ec);
+            };
+            bool failed;
+            {
+                std::unique_lock<std::mutex> lock(start_mutex_);
+                failed = startup_failed_;
+            }
+            // Nothing runs the worker's handlers (anymore, or at all if the server failed to start), or this is the worker
+            if (failed || context.stopped() || context.get_executor().running_in_this_thread())
+            {
+                close();
+                return;
+            }
+            if (!wait)
+            {
+                asio::post(context, close);
+                return;
+            }
+            std::promise<void> closed;
+            asio::post(context, [&closed, close] {
+                close();
+                closed.set_value();
+            });
+            closed.get_future().wait();
+        }
+
+        void do_handoff_accept()
+        {
+            auto channel = std::make_shared<stream_protocol::socket>(io_context_);
+            handoff_acceptor_.async_accept(*channel, [this, channel](error_code ec) {
+                if (ec)
+                    return;
+                if (!detail::handoff::same_user(channel->native_handle()))
+                {
+                    CROW_LOG_WARNING << "Refused to hand the listening socket over to a process of another user";
+                    do_handoff_accept();
+                    return;
+                }
+                if (shutting_down_ || !detail::handoff::send_fd(channel->native_handle(), acceptor_.raw_acceptor().native_handle()))
+                {
+                    CROW_LOG_WARNING << "Failed to hand the listening socket over";
+                    do_handoff_accept();
+                    return;
+                }
+                CROW_LOG_INFO << "Handed the listening socket over to a new process";
+                handed_off_ = true;
+                handoff_acceptor_.close(ec);
+                if (handoff_function_)
+                    handoff_function_();
+            });
         }
 
+        void wait_for_drain(std::chrono::steady_clock::time_point deadline, std::function<bool()> done)
+        {
+            if (done())
+            {
+                CROW_LOG_INFO << "All connections drained";
+                stop();
+                return;
+            }
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                CROW_LOG_WARNING << "Drain deadline reached with " << connection_count() << " connections still open, stopping anyway";
+                stop();
+                return;
+            }
+            drain_timer_.expires_after(std::chrono::milliseconds(10));
+            drain_timer_.async_wait([this, deadline, done](const error_code& ec) {
+                if (!ec)
+                    wait_for_drain(deadline, done);
+            });
+        }
+
+        size_t pick_io_context_idx()
+        {
+            return load_balancer_.pick(worker_load_pool_);
+        }
+
+        /// Wait for connections on the listening socket.
         void do_accept()
         {
             if (!shutting_down_)
             {
-                size_t context_idx = pick_io_context_idx();
-                asio::io_context& ic = *io_context_pool_[context_idx];
-                auto p = std::make_shared<Connection<Adaptor, Handler, Middlewares...>>(
-                    ic, handler_, server_name_, middlewares_,
-                    get_cached_date_str_pool_[context_idx], *task_timer_pool_[context_idx], adaptor_ctx_, task_queue_length_pool_[context_idx]);
-                    
-                CROW_LOG_DEBUG << &ic << " {" << context_idx << "} queue length: " << task_queue_length_pool_[context_idx];
-
-                acceptor_.raw_acceptor().async_accept(
-                  p->socket(),
-                  [this, p, &ic](error_code ec) {
+                acceptor_.raw_acceptor().async_wait(
+                  asio::socket_base::wait_read,
+                  [this](error_code ec) {
                       if (!ec)
-                      {
-                          detail::socket::apply_tcp_socket_options(p->socket(), tcp_socket_options_);
-                          asio::post(ic,
-                            [p] {
-                                p->start();
-                            });
-                      }
+                          accept_pending(acceptor_, -1);
                       do_accept();
                   });
             }
         }
 
+        /// Accept the connections waiting on `acceptor`, for `worker` (which runs this), or each for the worker picked for it as it arrives if `worker` is -1.
+        void accept_pending(Acceptor& acceptor, int worker)
+        {
+            error_code ec;
+            auto protocol = acceptor.raw_acceptor().local_endpoint(ec).protocol();
+            while (!shutting_down_)
+            {
+                // The worker is only picked (and the connection made) once there is one, the last accept finds none
+                auto socket = acceptor.raw_acceptor().accept(ec);
+                if (ec)
+                    return; // None left, the acceptor doesn't block
+
+                size_t context_idx = worker < 0 ? pick_io_context_idx() : static_cast<size_t>(worker);
+                auto p = make_connection(context_idx);
+                if (worker < 0)
+                {
+                    // Accepted on the acceptor's io_context, the socket is moved over to the worker's
+                    auto handle = socket.release(ec);
+                    if (!ec)
+                        p->socket().assign(protocol, handle, ec);
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << "Failed to hand an accepted connection to a worker: " << ec.message();
+                        continue;
+                    }
+                }
+                else
+                {
+                    p->socket() = std::move(socket);
+                }
+                CROW_LOG_DEBUG << io_context_pool_[context_idx].get() << " {" << context_idx << "} connections: " << worker_load_pool_[context_idx].connections
+                               << ", pending requests: " << worker_load_pool_[context_idx].pending_requests;
+                if (!admit(*p, context_idx))
+                    continue;
+                detail::socket::apply_tcp_socket_options(p->socket(), tcp_socket_options_);
+                if (worker < 0)
+                {
+                    asio::post(*io_context_pool_[context_idx],
+                      [p] {
+                          p->start();
+                      });
+                }
+                else
+                {
+                    p->start();
+                }
+            }
+        }
+
+        /// A connection for the worker `context_idx`, in memory from the worker's pool.
+        std::shared_ptr<Connection<Adaptor, Handler, Middlewares...>> make_connection(size_t context_idx)
+        {
+            return std::allocate_shared<Connection<Adaptor, Handler, Middlewares...>>(
+              detail::connection_pool_allocator<Connection<Adaptor, Handler, Middlewares...>>(&connection_pools_[context_idx]),
+              *io_context_pool_[context_idx], handler_, server_header_, middlewares_,
+              *date_header_pool_[context_idx], *task_timer_pool_[context_idx], read_buffer_pools_[context_idx], adaptor_ctx_, worker_load_pool_[context_idx], connection_lists_[context_idx], admission_);
+        }
+
+        /// Whether a newly accepted connection is within the limits, it's turned away if not.
+        bool admit(Connection<Adaptor, Handler, Middlewares...>& connection, size_t context_idx)
+        {
+            if (!admission_.enabled())
+                return true;
+
+            asio::ip::address address;
+            const asio::ip::address* peer = nullptr;
+            if constexpr (std::is_same<Acceptor, TCPAcceptor>::value)
+            {
+                error_code ec;
+                address = connection.socket().remote_endpoint(ec).address();
+                if (!ec)
+                    peer = &address;
+            }
+            if (admission_.admit_connection(context_idx, peer))
+            {
+                connection.admitted(peer);
+                return true;
+            }
+
+            CROW_LOG_DEBUG << "Connection turned away, over the connection limits";
+            if constexpr (Adaptor::encrypted)
+            {
+                // There's no answering before the TLS handshake, closing is cheaper than doing one
+                error_code ec;
+                connection.socket().close(ec);
+            }
+            else
+            {
+                detail::shed_connection(std::move(connection.socket()), admission_.shed_response());
+            }
+            return false;
+        }
+
+        /// Open a listening socket on the server's port for every worker, see \ref reuse_port_.
+        bool open_worker_acceptors()
+        {
+            if constexpr (Acceptor::supports_reuse_port)
+            {
+                auto endpoint = acceptor_.local_endpoint();
+                for (size_t i = 0; i < io_context_pool_.size(); i++)
+                {
+                    worker_acceptors_.emplace_back(new Acceptor(*io_context_pool_[i]));
+                    auto& acceptor = worker_acceptors_.back()->raw_acceptor();
+                    error_code ec;
+                    acceptor.open(endpoint.protocol(), ec);
+                    if (!ec)
+                        acceptor.set_option(Acceptor::reuse_address_option(), ec);
+                    if (!ec)
+                        acceptor.set_option(Acceptor::reuse_port_option(), ec);
+                    if constexpr (Acceptor::supports_incoming_cpu)
+                    {
+                        // Prefer connections whose packets the kernel processes on the worker's CPU
+                        if (!ec && !worker_cpus_.empty())
+                        {
+                            error_code cpu_ec;
+                            acceptor.set_option(Acceptor::incoming_cpu_option(worker_cpu(i)), cpu_ec);
+                            if (cpu_ec)
+                                CROW_LOG_WARNING << "Failed to set SO_INCOMING_CPU: " << cpu_ec.message();
+                        }
+                    }
+                    if (!ec)
+                        acceptor.bind(endpoint, ec);
+                    if (!ec)
+                        acceptor.listen(tcp::acceptor::max_listen_connections, ec);
+                    if (!ec)
+                        acceptor.non_blocking(true, ec);
+                    if (ec)
+                    {
+                        CROW_LOG_ERROR << "Failed to open a worker acceptor on port " << endpoint.port() << ": " << ec.message();
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        /// Accept connections on the worker's own socket, they are handled on the same thread.
+        void do_worker_accept(size_t context_idx)
+        {
+            if (shutting_down_)
+                return;
+
+            worker_acceptors_[context_idx]->raw_acceptor().async_wait(
+              asio::socket_base::wait_read,
+              [this, context_idx](error_code ec) {
+                  if (ec == asio::error::operation_aborted)
+                      return;
+                  if (!ec)
+                      accept_pending(*worker_acceptors_[context_idx], static_cast<int>(context_idx));
+                  do_worker_accept(context_idx);
+              });
+        }
+
+        int worker_cpu(size_t worker) const
+        {
+            return worker_cpus_[worker % worker_cpus_.size()];
+        }
+
         /// Notify anything using `wait_for_start()` to proceed
         void notify_start()
         {
@@ -342,13 +795,23 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
     private:
         unsigned int concurrency_{2};
-        std::vector<std::atomic<unsigned int>> task_queue_length_pool_;
+        std::vector<detail::worker_load_counters> worker_load_pool_;
+        std::vector<detail::connection_list> connection_lists_;
+        detail::load_balancer load_balancer_;
+        detail::admission_control admission_;
+        crow::connection_allocator connection_allocator_;
+        size_t connection_pool_size_{0};
+        size_t static_file_cache_size_{0};
+        std::chrono::milliseconds static_file_cache_ttl_{std::chrono::seconds(1)};
+        std::vector<detail::connection_pool> connection_pools_; ///< Outlives the io_contexts, which may hold the last references to connections.
+        std::vector<detail::read_buffer_pool> read_buffer_pools_;
         std::vector<std::unique_ptr<asio::io_context>> io_context_pool_;
         asio::io_context io_context_;
         std::vector<detail::task_timer*> task_timer_pool_;
-        std::vector<std::function<std::string()>> get_cached_date_str_pool_;
+        std::vector<detail::date_header*> date_header_pool_;
         Acceptor acceptor_;
-        bool shutting_down_ = false;
+        std::vector<std::unique_ptr<Acceptor>> worker_acceptors_; ///< One per worker when `reuse_port_` is set.
+        std::atomic<bool> shutting_down_{false};
         bool server_started_{false};
         bool startup_failed_ = false;
         std::condition_variable cv_started_;
@@ -356,10 +819,18 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         asio::signal_set signals_;
 
         asio::basic_waitable_timer<std::chrono::high_resolution_clock> tick_timer_;
+        asio::steady_timer drain_timer_;
+        bool draining_{false}; ///< Only used on the main io_context.
+        std::function<void()> signal_function_;
+        stream_protocol::acceptor handoff_acceptor_;
+        std::string handoff_path_;
+        std::function<void()> handoff_function_;
+        bool handed_off_{false};
 
         Handler* handler_;
         std::uint8_t timeout_;
         std::string server_name_;
+        std::string server_header_; ///< Serialized once for all responses.
         bool use_unix_;
 
         std::chrono::milliseconds tick_interval_;
@@ -369,5 +840,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
         typename Adaptor::context* adaptor_ctx_;
         detail::socket::tcp_socket_options tcp_socket_options_;
+        bool reuse_port_; ///< Whether every worker accepts its own connections on an SO_REUSEPORT socket.
+        bool inherited_socket_{false};
+        std::vector<int> worker_cpus_;
+        int acceptor_cpu_{-1};
+        std::vector<std::string> worker_locations_; ///< The CPU each worker runs on, for the startup log.
     };
 } // namespace crow
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    /// How new connections are spread between the worker threads.
+    enum class load_balancing
+    {
+        /// Hand connections to the workers in turn.
+        round_robin,
+        /// Pick the worker with the fewest open connections.
+        least_connections,
+        /// Pick the less loaded of two random workers, the load being the requests the worker is handling times its average handling time.
+        power_of_two_choices,
+    };
+
+    /// A snapshot of how busy a worker thread is.
+    struct worker_load
+    {
+        unsigned int connections{};              ///< Open connections handled by the worker.
+        unsigned int pending_requests{};         ///< Requests whose handler hasn't responded yet.
+        std::chrono::microseconds latency{};     ///< Moving average of the time from a request arriving to its response being ready.
+        std::uint64_t requests{};                ///< Requests handled since the server started.
+    };
+
+    namespace detail
+    {
+        /// Load counters of a single worker thread, updated by the connections it handles and read by the acceptor.
+        struct worker_load_counters
+        {
+            std::atomic<unsigned int> connections{0};
+            std::atomic<unsigned int> pending_requests{0};
+            std::atomic<std::uint64_t> latency_us{0}; ///< Exponentially weighted moving average, in microseconds.
+            std::atomic<std::uint64_t> requests{0};
+
+            void reset()
+            {
+                connections = 0;
+                pending_requests = 0;
+                latency_us = 0;
+                requests = 0;
+            }
+
+            void request_started()
+            {
+                pending_requests++;
+            }
+
+            /// Count a request out, `latency` is only added to the average if the response was sent.
+            void request_finished(std::chrono::steady_clock::duration latency, bool sent = true)
+            {
+                pending_requests--;
+                if (!sent)
+                    return;
+                requests++;
+
+                // Same weight as TCP's smoothed RTT (1/8), a racing update from another thread only loses a sample
+                auto sample = static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+                auto average = static_cast<std::int64_t>(latency_us.load(std::memory_order_relaxed));
+                average = average == 0 ? sample : average + (sample - average) / 8;
+                latency_us.store(static_cast<std::uint64_t>(average), std::memory_order_relaxed);
+            }
+
+            /// How long a new request would likely wait on this worker.
+            std::uint64_t cost() const
+            {
+                // A worker's first request counts as well, before there's an average
+                return static_cast<std::uint64_t>(pending_requests) * std::max<std::uint64_t>(latency_us.load(std::memory_order_relaxed), 1);
+            }
+
+            worker_load snapshot() const
+            {
+                return {connections, pending_requests, std::chrono::microseconds(latency_us.load(std::memory_order_relaxed)), requests};
+            }
+        };
+
+        /// Picks the worker for each new connection, only used by the thread accepting connections.
+        class load_balancer
+        {
+        public:
+            explicit load_balancer(load_balancing strategy = load_balancing::least_connections):
+              strategy_(strategy), random_(std::random_device{}())
+            {}
+
+            void strategy(load_balancing strategy)
+            {
+                strategy_ = strategy;
+            }
+
+            load_balancing strategy() const
+            {
+                return strategy_;
+            }
+
+            size_t pick(const std::vector<worker_load_counters>& workers)
+            {
+                if (workers.size() < 2)
+                    return 0;
+
+                switch (strategy_)
+                {
+                    case load_balancing::round_robin:
+                        return next_++ % workers.size();
+                    case load_balancing::power_of_two_choices:
+                        return pick_power_of_two(workers);
+                    case load_balancing::least_connections:
+                    default:
+                        return pick_least_connections(workers);
+                }
+            }
+
+        private:
+            static size_t pick_least_connections(const std::vector<worker_load_counters>& workers)
+            {
+                size_t min_idx = 0;
+                // size_t is used here to avoid the security issue https://codeql.github.com/codeql-query-help/cpp/cpp-comparison-with-wider-type/
+                // even though the max value of this can be only uint16_t as concurrency is uint16_t.
+                for (size_t i = 1; i < workers.size() && workers[min_idx].connections > 0; i++)
+                // No need to check other workers if the current one has no connections
+                {
+                    if (workers[i].connections < workers[min_idx].connections)
+                        min_idx = i;
+                }
+                return min_idx;
+            }
+
+            size_t pick_power_of_two(const std::vector<worker_load_counters>& workers)
+            {
+                std::uniform_int_distribution<size_t> distribution(0, workers.size() - 1);
+                size_t a = distribution(random_);
+                size_t b = distribution(random_);
+                if (a == b)
+                    b = (a + 1) % workers.size();
+
+                auto cost_a = workers[a].cost(), cost_b = workers[b].cost();
+                if (cost_a != cost_b)
+                    return cost_a < cost_b ? a : b;
+                // Idle (or equally busy) workers, prefer the one with less connections that might become busy
+                return workers[b].connections < workers[a].connections ? b : a;
+            }
+
+        private:
+            load_balancing strategy_;
+            size_t next_{0};
+            std::minstd_rand random_;
+        };
+    } // namespace detail
+} // namespace crow
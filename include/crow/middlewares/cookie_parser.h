@@ -231,7 +231,7 @@ namespace crow
 
         void before_handle(request& req, response& res, context& ctx)
         {
-            const int count = req.headers.count("Cookie");
+            const size_t count = req.header_count("Cookie");
             if (!count)
                 return;
             if (count > 1)
@@ -241,7 +241,7 @@ namespace crow
                 return;
             }
 
-            const std::string_view cookies_sv = req.get_header_value("Cookie");
+            const std::string_view cookies_sv = req.header("Cookie");
 
             size_t pos = 0;
             while (pos < cookies_sv.size())
@@ -144,7 +144,7 @@ namespace crow
             /// Create a multipart message from a request data
             explicit message(const request& req):
               returnable("multipart/form-data; boundary=CROW-BOUNDARY"),
-              headers(req.headers),
+              headers(req.get_headers()),
               boundary(get_boundary(get_header_value("Content-Type")))
             {
                 if (!boundary.empty())
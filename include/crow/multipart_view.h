@@ -183,7 +183,7 @@ namespace crow
 
             /// Create a multipart message from a request data
             explicit message_view(const request& req):
-              headers(req.headers),
+              headers(req.get_headers()),
               boundary(get_boundary(get_header_value("Content-Type")))
             {
                 parse_body(req.body);
@@ -6,6 +6,7 @@
 
 #include "crow/http_request.h"
 #include "crow/http_parser_merged.h"
+#include "crow/http_parser_fast.h"
 
 namespace crow
 {
@@ -30,6 +31,18 @@ namespace crow
         static int on_url(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            if (self->request_views)
+            {
+                // Reuse the memory of the previous request's URL, and only parse a query string if there is one
+                auto& req = self->req;
+                req.raw_url.append(at, length);
+                if (req.raw_url.find('?') != std::string::npos)
+                    req.url_params = query_string(req.raw_url);
+                req.url.assign(req.raw_url, 0, self->qs_point != 0 ? self->qs_point : std::string::npos);
+
+                self->process_url();
+                return 0;
+            }
             self->req.raw_url.insert(self->req.raw_url.end(), at, at + length);
             self->req.url_params = query_string(self->req.raw_url);
             self->req.url = self->req.raw_url.substr(0, self->qs_point != 0 ? self->qs_point : std::string::npos);
@@ -41,6 +54,19 @@ namespace crow
         static int on_header_field(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            if (self->request_views)
+            {
+                // A header may arrive in several parts, each one goes right after the previous in the request's header data
+                auto& req = self->req;
+                if (self->header_building_state == 0)
+                {
+                    req.header_spans_.push_back({static_cast<uint32_t>(req.header_data_.size()), 0, 0, 0});
+                    self->header_building_state = 1;
+                }
+                req.header_data_.append(at, length);
+                req.header_spans_.back().name_length += static_cast<uint32_t>(length);
+                return 0;
+            }
             switch (self->header_building_state)
             {
                 case 0:
@@ -60,6 +86,18 @@ namespace crow
         static int on_header_value(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            if (self->request_views)
+            {
+                auto& req = self->req;
+                if (self->header_building_state == 1)
+                {
+                    req.header_spans_.back().value = static_cast<uint32_t>(req.header_data_.size());
+                    self->header_building_state = 0;
+                }
+                req.header_data_.append(at, length);
+                req.header_spans_.back().value_length += static_cast<uint32_t>(length);
+                return 0;
+            }
             switch (self->header_building_state)
             {
                 case 0:
@@ -88,6 +126,13 @@ namespace crow
         static int on_body(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            if (self->stream_body)
+            {
+                // Stop right after this part if the receiver can't take more for now
+                if (!self->handler_->handle_body(at, length))
+                    http_parser_pause(self, 1);
+                return 0;
+            }
             self->req.body.insert(self->req.body.end(), at, at + length);
             return 0;
         }
@@ -97,6 +142,9 @@ namespace crow
 
             self->message_complete = true;
             self->process_message();
+            // Stop right after the message, anything following it in the buffer belongs to the next request
+            // and has to wait until the response for this one has been written.
+            http_parser_pause(self, 1);
             return 0;
         }
         HTTPParser(Handler* handler):
@@ -108,8 +156,12 @@ namespace crow
 
         // return false on error
         /// Parse a buffer into the different sections of an HTTP request.
+
+        ///
+        /// Parsing stops at the end of a complete message, \ref consumed() tells how much of the buffer was used.
         bool feed(const char* buffer, int length)
         {
+            consumed_ = 0;
             if (message_complete)
                 return true;
 
@@ -124,12 +176,48 @@ namespace crow
               on_message_complete,
             };
 
-            int nparsed = http_parser_execute(this, &settings_, buffer, length);
+            size_t nparsed;
+            detail::request_head head;
+            if (fast_head && state == CROW_NEW_MESSAGE() && http_errno == CHPE_OK && !lenient_http_headers && nread < max_header_size &&
+                detail::parse_request_head(buffer, length, max_header_size - nread, head))
+                nparsed = feed_head(head, buffer, length, settings_);
+            else
+                nparsed = http_parser_execute(this, &settings_, buffer, length);
+            consumed_ = nparsed;
+            if (http_errno == CHPE_PAUSED)
+            {
+                return true;
+            }
             if (http_errno != CHPE_OK)
             {
                 return false;
             }
-            return nparsed == length;
+            return nparsed == static_cast<size_t>(length);
+        }
+
+        /// The number of bytes used by the last call to \ref feed().
+        size_t consumed() const
+        {
+            return consumed_;
+        }
+
+        /// Whether parsing stopped, at the end of a complete message or because a streamed body's receiver asked for a break.
+        bool paused() const
+        {
+            return http_errno == CHPE_PAUSED;
+        }
+
+        /// Whether a complete message has been parsed.
+        bool message_done() const
+        {
+            return message_complete;
+        }
+
+        /// Continue parsing the body after a break, see \ref stream_body.
+        void resume_body()
+        {
+            if (paused() && !message_complete)
+                http_parser_pause(this, 0);
         }
 
         bool done()
@@ -139,12 +227,24 @@ namespace crow
 
         void clear()
         {
-            req = crow::request();
+            if (request_views)
+            {
+                req.recycle();
+                req.header_views_ = true;
+            }
+            else
+            {
+                req = crow::request();
+            }
             header_field.clear();
             header_value.clear();
             header_building_state = 0;
             qs_point = 0;
             message_complete = false;
+            stream_body = false;
+            consumed_ = 0;
+            if (paused())
+                http_parser_pause(this, 0);
             state = CROW_NEW_MESSAGE();
         }
 
@@ -187,9 +287,64 @@ namespace crow
         /// Data parsed is put directly into this object as soon as the related callback returns. (e.g. the request will have the cooorect method as soon as on_method() returns)
         request req;
 
+        /// Hand the body to the handler's `handle_body()` as it's parsed instead of collecting it in `req.body`.
+        bool stream_body = false;
+
+        /// Parse request heads that are complete in the buffer with \ref detail::parse_request_head() instead of one byte at a time.
+
+        ///
+        /// On by default when `CROW_ENABLE_FAST_PARSER` is defined. The results are the same either way,
+        /// heads the fast path doesn't take (split across reads, chunked, upgrades, unusual syntax) go to the state machine.
+#ifdef CROW_ENABLE_FAST_PARSER
+        bool fast_head = true;
+#else
+        bool fast_head = false;
+#endif
+
+        /// Keep the headers as views into one buffer instead of a \ref ci_map, and reuse the request's memory from one request to the next.
+
+        ///
+        /// Set before the first request, see \ref Crow::request_views().
+        bool request_views = false;
+
     private:
+        /// Make the same callbacks for a checked request head as the state machine would, then let it go on from the head's last line feed.
+        size_t feed_head(const detail::request_head& head, const char* buffer, size_t length, const http_parser_settings& settings)
+        {
+            flags = 0;
+            uses_transfer_encoding = 0;
+            content_length = CROW_ULLONG_MAX;
+            method = static_cast<unsigned>(head.method);
+            on_message_begin(this);
+            on_method(this);
+
+            // The handler may finish the request from here (no route), through done() which expects this state
+            state = s_req_http_start;
+            if (head.qs_point)
+                qs_point = head.qs_point;
+            on_url(this, buffer + head.url, head.url_length);
+            if (http_errno != CHPE_OK)
+                return head.url + head.url_length + 1;
+            http_major = head.http_major;
+            http_minor = head.http_minor;
+
+            for (size_t i = 0; i < head.header_count; i++)
+            {
+                const auto& h = head.headers[i];
+                on_header_field(this, buffer + h.name, h.name_length);
+                on_header_value(this, buffer + h.value, h.value_length);
+            }
+
+            flags = head.flags;
+            content_length = head.content_length;
+            state = s_headers_almost_done;
+            nread += static_cast<uint32_t>(head.length - 1);
+            return head.length - 1 + http_parser_execute(this, &settings, buffer + head.length - 1, length - (head.length - 1));
+        }
+
         int header_building_state = 0;
         bool message_complete = false;
+        size_t consumed_ = 0;
         std::string header_field;
         std::string header_value;
 
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    namespace detail
+    {
+        /// Memory for the data of one request at a time, handed out monotonically and taken back all at once before the next request.
+
+        ///
+        /// Deallocating does nothing, \ref reset() makes the whole arena available again.
+        /// The blocks are kept across resets (up to \ref max_kept_size bytes of them), so that once the first requests on a connection have sized the arena, the next ones don't go to the heap.
+        /// Only for data that can't outlive the request, and used from one thread at a time.
+        class request_arena : public std::pmr::memory_resource
+        {
+        public:
+            static constexpr std::size_t block_size = 512;     ///< The size of the first block, each new block is twice as large as the one before.
+            static constexpr std::size_t max_kept_size = 4096; ///< The blocks past this size are given back on reset (grown by an unusually large request).
+
+            request_arena() = default;
+            request_arena(const request_arena&) = delete;
+            request_arena& operator=(const request_arena&) = delete;
+
+            ~request_arena()
+            {
+                release(blocks_);
+            }
+
+            /// Make all of the memory available again, everything allocated from the arena must be gone by then.
+            void reset()
+            {
+                std::size_t kept = 0;
+                block** link = &blocks_;
+                while (*link && kept + (*link)->size <= max_kept_size)
+                {
+                    kept += (*link)->size;
+                    link = &(*link)->next;
+                }
+                release(*link);
+                *link = nullptr;
+                current_ = blocks_;
+                used_ = 0;
+            }
+
+            /// The bytes held by the arena, whether they're in use or not.
+            std::size_t capacity() const
+            {
+                std::size_t size = 0;
+                for (block* b = blocks_; b; b = b->next)
+                    size += b->size;
+                return size;
+            }
+
+        private:
+            struct alignas(std::max_align_t) block
+            {
+                block* next;
+                std::size_t size; ///< The bytes after the block header.
+
+                char* data() { return reinterpret_cast<char*>(this + 1); }
+            };
+
+            void* do_allocate(std::size_t bytes, std::size_t alignment) override
+            {
+                while (true)
+                {
+                    if (current_)
+                    {
+                        void* p = current_->data() + used_;
+                        std::size_t space = current_->size - used_;
+                        if (std::align(alignment, bytes, p, space))
+                        {
+                            used_ = static_cast<char*>(p) - current_->data() + bytes;
+                            return p;
+                        }
+                        if (current_->next)
+                        {
+                            // A block kept from before the last reset
+                            current_ = current_->next;
+                            used_ = 0;
+                            continue;
+                        }
+                    }
+                    add_block(bytes + alignment);
+                }
+            }
+
+            void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+
+            /// Add a block of at least `min_size` bytes after the current one.
+            void add_block(std::size_t min_size)
+            {
+                std::size_t size = std::max(min_size, current_ ? current_->size * 2 : block_size);
+                block* b = static_cast<block*>(::operator new(sizeof(block) + size));
+                b->size = size;
+                if (current_)
+                {
+                    b->next = current_->next;
+                    current_->next = b;
+                }
+                else
+                {
+                    b->next = blocks_;
+                    blocks_ = b;
+                }
+                current_ = b;
+                used_ = 0;
+            }
+
+            static void release(block* b)
+            {
+                while (b)
+                {
+                    block* next = b->next;
+                    ::operator delete(b);
+                    b = next;
+                }
+            }
+
+        private:
+            block* blocks_{};
+            block* current_{};
+            std::size_t used_{}; ///< The bytes of the current block in use.
+        };
+    } // namespace detail
+} // namespace crow
@@ -18,6 +18,7 @@
 #include "crow/logging.h"
 #include "crow/exceptions.h"
 #include "crow/websocket.h"
+#include "crow/sse.h"
 #include "crow/mustache.h"
 #include "crow/middleware.h"
 
@@ -140,6 +141,18 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             return methods_;
         }
 
+        /// Whether the request body is handed to the handler while it's received, see `stream_body()`.
+        bool streams_body() const
+        {
+            return stream_body_;
+        }
+
+        /// Whether the handler runs on the handler thread pool, see `offload()`.
+        bool offloads_handler() const
+        {
+            return offload_;
+        }
+
         template<typename F>
         void foreach_method(F f)
         {
@@ -162,6 +175,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         bool added_{false};
 
         std::unique_ptr<BaseRule> rule_to_upgrade_;
+        bool stream_body_{false};
+        bool offload_{false};
 
         detail::middleware_indices mw_indices_;
 
@@ -574,6 +589,108 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         std::vector<std::string> subprotocols_;
     };
 
+    /// A rule that keeps the connection open to push Server-Sent Events (`text/event-stream`) to the client.
+
+    ///
+    /// Provides the interface for the user to put in the handlers for an event stream.
+    template<typename App>
+    class SSERule : public BaseRule
+    {
+        using self_t = SSERule;
+
+    public:
+        SSERule(std::string rule, App* app):
+          BaseRule(std::move(rule)),
+          app_(app)
+        {}
+
+        void validate() override
+        {}
+
+        void handle(request& req, response& res, const routing_params&) override
+        {
+            if (accept_handler_ && !accept_handler_(req))
+            {
+                res = response(403);
+                res.end();
+                return;
+            }
+
+            res.set_header("Content-Type", "text/event-stream");
+            res.set_header("Cache-Control", "no-cache");
+            auto stream = res.stream();
+            if (!stream->is_open())
+                return; // HEAD request
+
+            auto app = app_;
+            auto close_handler = close_handler_;
+            auto conn = std::make_shared<sse::connection>(req, std::move(stream), [app, close_handler](sse::connection& closed) {
+                if (close_handler)
+                    close_handler(closed);
+                app->remove_sse_connection(closed.shared_from_this());
+            });
+            app_->add_sse_connection(conn);
+            if (open_handler_)
+                open_handler_(*conn);
+            conn->start_heartbeat(heartbeat_interval_);
+        }
+
+        /// \brief Set functor that is called when a client subscribes.
+        ///     The required interface is:
+        ///         void(crow::sse::connection& conn)
+        ///
+        /// \param f Functor to set.
+        ///
+        template<typename Func>
+        self_t& onopen(Func f)
+        {
+            open_handler_ = f;
+            return *this;
+        }
+
+        /// \brief Set functor that is called when the event stream ends, because it was closed or the client left.
+        ///     The required interface is:
+        ///         void(crow::sse::connection& conn)
+        ///
+        /// \param f Functor to set.
+        ///
+        template<typename Func>
+        self_t& onclose(Func f)
+        {
+            close_handler_ = f;
+            return *this;
+        }
+
+        /// \brief Set functor that decides whether a client may subscribe (otherwise it gets a 403).
+        ///     The required interface is:
+        ///         bool(const crow::request& req)
+        ///
+        /// \param f Functor to set.
+        ///
+        template<typename Func>
+        self_t& onaccept(Func f)
+        {
+            accept_handler_ = f;
+            return *this;
+        }
+
+        /// \brief Send a comment every `seconds` if no event was sent in between, 0 disables it (Default: 15).
+        ///
+        /// Keeps proxies from closing idle streams, and is how clients that left get noticed.
+        self_t& heartbeat(uint8_t seconds)
+        {
+            heartbeat_interval_ = seconds;
+            return *this;
+        }
+
+    protected:
+        App* app_;
+        std::function<void(crow::sse::connection&)> open_handler_;
+        std::function<void(crow::sse::connection&)> close_handler_;
+        std::function<bool(const crow::request&)> accept_handler_;
+        uint8_t heartbeat_interval_ = 15;
+    };
+
     /// Allows the user to assign parameters using functions.
 
     ///
@@ -591,12 +708,40 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             return *p;
         }
 
+        template<typename App>
+        SSERule<App>& sse(App* app)
+        {
+            auto p = new SSERule<App>(static_cast<self_t*>(this)->rule_, app);
+            static_cast<self_t*>(this)->rule_to_upgrade_.reset(p);
+            return *p;
+        }
+
         self_t& name(std::string name) noexcept
         {
             static_cast<self_t*>(this)->name_ = std::move(name);
             return static_cast<self_t&>(*this);
         }
 
+        /// Let the handler receive the request body through `req.body_stream` while it arrives, instead of in `req.body`.
+
+        ///
+        /// The handler is then called as soon as the request headers are in.
+        self_t& stream_body(bool enabled = true)
+        {
+            static_cast<self_t*>(this)->stream_body_ = enabled;
+            return static_cast<self_t&>(*this);
+        }
+
+        /// Run the handler on the handler thread pool instead of the connection's thread, for handlers that block (e.g. on a database).
+
+        ///
+        /// The response is still sent from the connection's thread.
+        self_t& offload(bool enabled = true)
+        {
+            static_cast<self_t*>(this)->offload_ = enabled;
+            return static_cast<self_t&>(*this);
+        }
+
         self_t& methods(HTTPMethod method)
         {
             static_cast<self_t*>(this)->methods_ = 1ULL << static_cast<int>(method);
@@ -888,20 +1033,20 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 
         //Rule_index, Blueprint_index, routing_params
-        routing_handle_result find(const std::string& req_url, const Node& node, size_t pos = 0, routing_params* params = nullptr, std::vector<size_t>* blueprints = nullptr) const
+        routing_handle_result find(const std::string& req_url, const Node& node, size_t pos = 0, routing_params* params = nullptr, std::pmr::vector<size_t>* blueprints = nullptr) const
         {
             //start params as an empty struct
             routing_params empty;
             if (params == nullptr)
                 params = &empty;
             //same for blueprint vector
-            std::vector<size_t> MT;
+            std::pmr::vector<size_t> MT(params->get_allocator());
             if (blueprints == nullptr)
                 blueprints = &MT;
 
-            size_t found{};               //The rule index to be found
-            std::vector<size_t> found_BP; //The Blueprint indices to be found
-            routing_params match_params;    //supposedly the final matched parameters
+            size_t found{};                                            //The rule index to be found
+            std::pmr::vector<size_t> found_BP(params->get_allocator()); //The Blueprint indices to be found
+            routing_params match_params(params->get_allocator());      //supposedly the final matched parameters
 
             auto update_found = [&found, &found_BP, &match_params](routing_handle_result& ret) {
                 found_BP = std::move(ret.blueprint_indices);
@@ -916,7 +1061,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             if (pos == req_url.size())
             {
                 found_BP = std::move(*blueprints);
-                return routing_handle_result{node.rule_index, *blueprints, *params};
+                return routing_handle_result{node.rule_index, std::pmr::vector<size_t>(*blueprints, params->get_allocator()), routing_params(*params, params->get_allocator())};
             }
 
             bool found_fragment = false;
@@ -1043,12 +1188,14 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             if (!found_fragment)
                 found_BP = std::move(*blueprints);
 
-            return routing_handle_result{found, found_BP, match_params}; //Called after all the recursions have been done
+            return routing_handle_result{found, std::move(found_BP), std::move(match_params)}; //Called after all the recursions have been done
         }
 
-        routing_handle_result find(const std::string& req_url) const
+        /// Find the rule for a URL, the parameters and blueprint indices of the result draw from `alloc`.
+        routing_handle_result find(const std::string& req_url, const routing_params::allocator_type& alloc = {}) const
         {
-            return find(req_url, head_);
+            routing_params params(alloc);
+            return find(req_url, head_, 0, &params);
         }
 
         //This functions assumes any blueprint info passed is valid
@@ -1190,6 +1337,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             catchall_rule_ = std::move(value.catchall_rule_);
             blueprints_ = std::move(value.blueprints_);
             mw_indices_ = std::move(value.mw_indices_);
+            offload_ = value.offload_;
             return *this;
         }
 
@@ -1269,6 +1417,12 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             mw_indices_.push<App, Middlewares...>();
         }
 
+        /// Run the handlers of all the blueprint's routes (including those of child blueprints) on the handler thread pool.
+        void offload(bool enabled = true)
+        {
+            offload_ = enabled;
+        }
+
     private:
         void apply_blueprint(Blueprint& blueprint)
         {
@@ -1295,6 +1449,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         CatchallRule catchall_rule_;
         std::vector<Blueprint*> blueprints_;
         detail::middleware_indices mw_indices_;
+        bool offload_{false};
         bool added_{false};
 
         friend class Router;
@@ -1355,6 +1510,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             }
 
             ruleObject->mw_indices_.pack();
+            if (ruleObject->offload_)
+                has_offloaded_handlers_ = true;
 
             ruleObject->foreach_method([&](int method) {
                 per_methods_[method].rules.emplace_back(ruleObject);
@@ -1409,10 +1566,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         {
             //Take all the routes from the registered blueprints and add them to `all_rules_` to be processed.
             detail::middleware_indices blueprint_mw;
-            validate_bp(blueprints_, blueprint_mw);
+            validate_bp(blueprints_, blueprint_mw, false);
         }
 
-        void validate_bp(std::vector<Blueprint*> blueprints, detail::middleware_indices& current_mw)
+        void validate_bp(std::vector<Blueprint*> blueprints, detail::middleware_indices& current_mw, bool offload)
         {
             for (unsigned i = 0; i < blueprints.size(); i++)
             {
@@ -1432,6 +1589,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 }
 
                 current_mw.merge_back(blueprint->mw_indices_);
+                bool offload_rules = offload || blueprint->offload_;
                 for (auto& rule : blueprint->all_rules_)
                 {
                     if (rule && !rule->is_added())
@@ -1441,10 +1599,12 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                             rule = std::move(upgraded);
                         rule->validate();
                         rule->mw_indices_.merge_front(current_mw);
+                        if (offload_rules)
+                            rule->offload_ = true;
                         internal_add_rule_object(rule->rule(), rule.get(), i, blueprints);
                     }
                 }
-                validate_bp(blueprint->blueprints_, current_mw);
+                validate_bp(blueprint->blueprints_, current_mw, offload_rules);
                 current_mw.pop_back(blueprint->mw_indices_);
                 blueprint->set_added();
             }
@@ -1527,7 +1687,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             }
         }
 
-        void get_found_bp(const std::vector<size_t>& bp_i, const std::vector<Blueprint*>& blueprints, std::vector<Blueprint*>& found_bps, size_t index = 0)
+        void get_found_bp(const std::pmr::vector<size_t>& bp_i, const std::vector<Blueprint*>& blueprints, std::vector<Blueprint*>& found_bps, size_t index = 0)
         {
             // This statement makes 3 assertions:
             // 1. The index is above 0.
@@ -1610,38 +1770,40 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
         std::unique_ptr<routing_handle_result> handle_initial(request& req, response& res)
         {
-            HTTPMethod method_actual = req.method;
+            std::unique_ptr<routing_handle_result> found{new routing_handle_result(routing_handle_result::allocator_type())}; // This is always returned to avoid a null pointer dereference.
+            handle_initial(req, res, *found);
+            return found;
+        }
 
-            std::unique_ptr<routing_handle_result> found{
-              new routing_handle_result(
-                0,
-                std::vector<size_t>(),
-                routing_params(),
-                HTTPMethod::InternalMethodCount)}; // This is always returned to avoid a null pointer dereference.
+        /// Find the route of a request into `found`, which is reset first and keeps its memory resource (the params can draw from a connection's arena).
+        void handle_initial(request& req, response& res, routing_handle_result& found)
+        {
+            HTTPMethod method_actual = req.method;
+            found = routing_handle_result(found.get_allocator());
 
             // NOTE(EDev): This most likely will never run since the parser should handle this situation and close the connection before it gets here.
             if (CROW_UNLIKELY(req.method >= HTTPMethod::InternalMethodCount))
-                return found;
+                return;
             else if (req.method == HTTPMethod::Head)
             {
-                *found = per_methods_[static_cast<int>(method_actual)].trie.find(req.url);
+                found = per_methods_[static_cast<int>(method_actual)].trie.find(req.url, found.get_allocator());
                 // support HEAD requests using GET if not defined as method for the requested URL
-                if (!found->rule_index)
+                if (!found.rule_index)
                 {
                     method_actual = HTTPMethod::Get;
-                    *found = per_methods_[static_cast<int>(method_actual)].trie.find(req.url);
-                    if (!found->rule_index) // If a route is still not found, return a 404 without executing the rest of the HEAD specific code.
+                    found = per_methods_[static_cast<int>(method_actual)].trie.find(req.url, found.get_allocator());
+                    if (!found.rule_index) // If a route is still not found, return a 404 without executing the rest of the HEAD specific code.
                     {
                         CROW_LOG_DEBUG << "Cannot match rules " << req.url;
                         res = response(404); //TODO(EDev): Should this redirect to catchall?
                         res.end();
-                        return found;
+                        return;
                     }
                 }
 
                 res.skip_body = true;
-                found->method = method_actual;
-                return found;
+                found.method = method_actual;
+                return;
             }
             else if (req.method == HTTPMethod::Options)
             {
@@ -1668,15 +1830,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
                     res.set_header("Allow", allow);
                     res.end();
-                    found->method = method_actual;
-                    return found;
+                    found.method = method_actual;
+                    return;
                 }
                 else
                 {
                     bool rules_matched = false;
                     for (int i = 0; i < static_cast<int>(HTTPMethod::InternalMethodCount); i++)
                     {
-                        if (per_methods_[i].trie.find(req.url).rule_index)
+                        if (per_methods_[i].trie.find(req.url, found.get_allocator()).rule_index)
                         {
                             rules_matched = true;
 
@@ -1696,50 +1858,70 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 #endif
                         res.set_header("Allow", allow);
                         res.end();
-                        found->method = method_actual;
-                        return found;
+                        found.method = method_actual;
+                        return;
                     }
                     else
                     {
                         CROW_LOG_DEBUG << "Cannot match rules " << req.url;
                         res = response(404); //TODO(EDev): Should this redirect to catchall?
                         res.end();
-                        return found;
+                        return;
                     }
                 }
             }
             else // Every request that isn't a HEAD or OPTIONS request
             {
-                *found = per_methods_[static_cast<int>(method_actual)].trie.find(req.url);
+                found = per_methods_[static_cast<int>(method_actual)].trie.find(req.url, found.get_allocator());
                 // TODO(EDev): maybe ending the else here would allow the requests coming from above (after removing the return statement) to be checked on whether they actually point to a route
-                if (!found->rule_index)
+                if (!found.rule_index)
                 {
                     for (auto& per_method : per_methods_)
                     {
-                        if (per_method.trie.find(req.url).rule_index) //Route found, but in another method
+                        if (per_method.trie.find(req.url, found.get_allocator()).rule_index) //Route found, but in another method
                         {
                             res.code = 405;
-                            found->catch_all = true;
+                            found.catch_all = true;
                             CROW_LOG_DEBUG << "Cannot match method " << req.url << " "
-                                           << method_name(method_actual) << ". " << get_error(*found);
-                            return found;
+                                           << method_name(method_actual) << ". " << get_error(found);
+                            return;
                         }
                     }
                     //Route does not exist anywhere
 
                     res.code = 404;
-                    found->catch_all = true;
-                    CROW_LOG_DEBUG << "Cannot match rules " << req.url << ". " << get_error(*found);
-                    return found;
+                    found.catch_all = true;
+                    CROW_LOG_DEBUG << "Cannot match rules " << req.url << ". " << get_error(found);
+                    return;
                 }
 
-                found->method = method_actual;
-                return found;
+                found.method = method_actual;
+                return;
             }
         }
 
+        /// Whether the route found for a request wants its body streamed, see \ref BaseRule::streams_body().
+        bool streams_body(const routing_handle_result& found)
+        {
+            auto rule = found_rule(found);
+            return rule && rule->streams_body();
+        }
+
+        /// Whether the handler of the route found for a request runs on the handler thread pool, see \ref BaseRule::offloads_handler().
+        bool offloads_handler(const routing_handle_result& found)
+        {
+            auto rule = found_rule(found);
+            return rule && rule->offloads_handler();
+        }
+
+        /// Whether any route runs its handler on the handler thread pool.
+        bool has_offloaded_handlers() const
+        {
+            return has_offloaded_handlers_;
+        }
+
         template<typename App>
-        void handle(request& req, response& res, routing_handle_result found)
+        void handle(request& req, response& res, const routing_handle_result& found)
         {
             if (found.catch_all) {
                 auto catch_all = get_catch_all(found);
@@ -1872,6 +2054,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 
     private:
+        /// The rule a request was matched to, if it has one.
+        BaseRule* found_rule(const routing_handle_result& found)
+        {
+            if (found.catch_all || !found.rule_index || found.rule_index == RULE_SPECIAL_REDIRECT_SLASH ||
+                found.method >= HTTPMethod::InternalMethodCount)
+                return nullptr;
+            const auto& rules = per_methods_[static_cast<int>(found.method)].rules;
+            return found.rule_index < rules.size() ? rules[found.rule_index] : nullptr;
+        }
+
         CatchallRule catchall_rule_;
 
         struct PerMethod
@@ -1887,5 +2079,6 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         std::vector<std::unique_ptr<BaseRule>> all_rules_;
         std::vector<Blueprint*> blueprints_;
         std::function<void(crow::response&)> exception_handler_ = &default_exception_handler;
+        bool has_offloaded_handlers_{false};
     };
 } // namespace crow
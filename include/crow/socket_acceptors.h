@@ -14,6 +14,8 @@
 #endif
 #endif
 
+#include <cerrno>
+
 #include "crow/logging.h"
 
 namespace crow
@@ -27,6 +29,32 @@ namespace crow
     using tcp = asio::ip::tcp;
     using stream_protocol = asio::local::stream_protocol;
 
+    namespace detail
+    {
+#ifndef _WIN32
+        /// The address family of the listening socket `fd`, sets `ec` if it isn't a listening socket.
+        inline int listening_socket_family(int fd, error_code& ec)
+        {
+            sockaddr_storage address{};
+            socklen_t length = sizeof(address);
+            int listening = 0;
+            socklen_t option_length = sizeof(listening);
+            if (::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0 ||
+                ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &option_length) != 0)
+            {
+                ec = error_code(errno, asio::error::get_system_category());
+                return -1;
+            }
+            if (!listening)
+            {
+                ec = asio::error::invalid_argument;
+                return -1;
+            }
+            return address.ss_family;
+        }
+#endif
+    } // namespace detail
+
     struct TCPAcceptor
     {
         using endpoint = tcp::endpoint;
@@ -56,6 +84,37 @@ namespace crow
             return acceptor_.local_endpoint();
         }
         inline static tcp::acceptor::reuse_address reuse_address_option() { return tcp::acceptor::reuse_address(true); }
+
+        /// Take over `fd`, a TCP socket that is already bound and listening (e.g. inherited from another process).
+        void assign(int fd, error_code& ec)
+        {
+#ifndef _WIN32
+            int family = detail::listening_socket_family(fd, ec);
+            if (!ec && family != AF_INET && family != AF_INET6)
+                ec = asio::error::address_family_not_supported;
+            if (!ec)
+                acceptor_.assign(family == AF_INET6 ? tcp::v6() : tcp::v4(), fd, ec);
+#else
+            (void)fd;
+            ec = asio::error::operation_not_supported;
+#endif
+        }
+
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+        /// Whether several sockets can listen on the same port, with the kernel spreading the connections between them.
+        static constexpr bool supports_reuse_port = true;
+        inline static asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port_option() { return asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true); }
+#else
+        static constexpr bool supports_reuse_port = false;
+#endif
+
+#if defined(SO_INCOMING_CPU)
+        /// Whether a listening socket can ask for the connections arriving on a given CPU (among the sockets sharing a port).
+        static constexpr bool supports_incoming_cpu = true;
+        inline static asio::detail::socket_option::integer<SOL_SOCKET, SO_INCOMING_CPU> incoming_cpu_option(int cpu) { return asio::detail::socket_option::integer<SOL_SOCKET, SO_INCOMING_CPU>(cpu); }
+#else
+        static constexpr bool supports_incoming_cpu = false;
+#endif
     };
 
     struct UnixSocketAcceptor
@@ -90,5 +149,23 @@ namespace crow
             // reuse addr must be false (https://github.com/chriskohlhoff/asio/issues/622)
             return stream_protocol::acceptor::reuse_address(false);
         }
+
+        /// Take over `fd`, a Unix socket that is already bound and listening (e.g. inherited from another process).
+        void assign(int fd, error_code& ec)
+        {
+#ifndef _WIN32
+            int family = detail::listening_socket_family(fd, ec);
+            if (!ec && family != AF_UNIX)
+                ec = asio::error::address_family_not_supported;
+            if (!ec)
+                acceptor_.assign(stream_protocol(), fd, ec);
+#else
+            (void)fd;
+            ec = asio::error::operation_not_supported;
+#endif
+        }
+
+        static constexpr bool supports_reuse_port = false;
+        static constexpr bool supports_incoming_cpu = false;
     };
 } // namespace crow
@@ -18,6 +18,17 @@
 #endif
 #include "crow/settings.h"
 
+#if defined(__linux__)
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#define CROW_CAN_SENDFILE
+#endif
+
 #if (defined(CROW_USE_BOOST) && BOOST_VERSION >= 107000) || (ASIO_VERSION >= 101008)
 #define GET_IO_CONTEXT(s) ((asio::io_context&)(s).get_executor().context())
 #else
@@ -39,6 +50,13 @@ namespace crow
     struct SocketAdaptor
     {
         using context = void;
+        static constexpr bool encrypted = false;
+#ifdef CROW_CAN_SENDFILE
+        /// Whether file contents can be sent with \ref async_sendfile().
+        static constexpr bool supports_sendfile = true;
+#else
+        static constexpr bool supports_sendfile = false;
+#endif
         SocketAdaptor(asio::io_context& io_context, context*):
           socket_(io_context)
         {}
@@ -105,12 +123,77 @@ namespace crow
             f(error_code());
         }
 
+#ifdef CROW_CAN_SENDFILE
+        /// Send `count` bytes of the open file `fd` starting at `offset`, without copying them through user space.
+
+        ///
+        /// Whenever the socket's send buffer is full the remaining bytes are sent once it becomes writable again.
+        /// `f(ec, bytes_transferred)` is always called from the socket's io_context, never from within this function.
+        template<typename F>
+        void async_sendfile(int fd, off_t offset, size_t count, F f, size_t transferred = 0)
+        {
+            error_code ec;
+            socket_.native_non_blocking(true, ec);
+
+            // Unlike send(), sendfile() has no MSG_NOSIGNAL. SIGPIPE is blocked on this thread while sending,
+            // and a SIGPIPE caused by a peer that went away is consumed instead of reaching the process.
+            sigset_t sigpipe_mask, pending, old_mask;
+            sigemptyset(&sigpipe_mask);
+            sigaddset(&sigpipe_mask, SIGPIPE);
+            sigpending(&pending);
+            bool sigpipe_was_pending = sigismember(&pending, SIGPIPE);
+            pthread_sigmask(SIG_BLOCK, &sigpipe_mask, &old_mask);
+
+            while (!ec && transferred < count)
+            {
+                ssize_t n = ::sendfile(socket_.native_handle(), fd, &offset, count - transferred);
+                if (n > 0)
+                {
+                    transferred += n;
+                }
+                else if (n == 0)
+                {
+                    // The file got shorter than expected
+                    ec = asio::error::eof;
+                }
+                else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+                    socket_.async_wait(tcp::socket::wait_write, [this, fd, offset, count, f, transferred](const error_code& wait_ec) mutable {
+                        if (wait_ec)
+                            f(wait_ec, transferred);
+                        else
+                            async_sendfile(fd, offset, count, std::move(f), transferred);
+                    });
+                    return;
+                }
+                else if (errno != EINTR)
+                {
+                    ec = error_code(errno, asio::error::get_system_category());
+                }
+            }
+
+            if (ec == asio::error::broken_pipe && !sigpipe_was_pending)
+            {
+                timespec no_wait{0, 0};
+                sigtimedwait(&sigpipe_mask, nullptr, &no_wait);
+            }
+            pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+
+            asio::post(socket_.get_executor(), [f, ec, transferred]() mutable {
+                f(ec, transferred);
+            });
+        }
+#endif
+
         tcp::socket socket_;
     };
 
     struct UnixSocketAdaptor
     {
         using context = void;
+        static constexpr bool encrypted = false;
+        static constexpr bool supports_sendfile = false;
         UnixSocketAdaptor(asio::io_context& io_context, context*):
           socket_(io_context)
         {
@@ -184,6 +267,8 @@ namespace crow
     {
         using context = asio::ssl::context;
         using ssl_socket_t = asio::ssl::stream<tcp::socket>;
+        static constexpr bool encrypted = true;
+        static constexpr bool supports_sendfile = false; // The data has to be encrypted first
         SSLAdaptor(asio::io_context& io_context, context* ctx):
           ssl_socket_(new ssl_socket_t(io_context, *ctx))
         {}
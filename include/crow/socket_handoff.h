@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "crow/logging.h"
+
+namespace crow
+{
+    namespace detail
+    {
+        /// Passing listening sockets between processes, so that a restart doesn't refuse any connection.
+        namespace handoff
+        {
+#ifndef _WIN32
+            constexpr bool supported = true;
+
+            /// The first socket passed by systemd socket activation (`LISTEN_PID` / `LISTEN_FDS`, see sd_listen_fds(3)), -1 if there is none.
+            inline int systemd_listen_fd()
+            {
+                constexpr int first_fd = 3; // SD_LISTEN_FDS_START
+                const char* pid = std::getenv("LISTEN_PID");
+                const char* fds = std::getenv("LISTEN_FDS");
+                if (!pid || !fds)
+                    return -1;
+                bool for_this_process = std::strtol(pid, nullptr, 10) == static_cast<long>(::getpid());
+                long count = std::strtol(fds, nullptr, 10);
+                // Like sd_listen_fds(1), so that processes started from this one don't take the sockets for theirs
+                ::unsetenv("LISTEN_PID");
+                ::unsetenv("LISTEN_FDS");
+                ::unsetenv("LISTEN_FDNAMES");
+                if (!for_this_process || count < 1)
+                    return -1;
+                if (count > 1)
+                    CROW_LOG_WARNING << "systemd passed " << count << " sockets, only the first one is used";
+                ::fcntl(first_fd, F_SETFD, FD_CLOEXEC);
+                return first_fd;
+            }
+
+            /// Whether the process on the other end of a Unix socket runs as the same user as this one.
+            inline bool same_user(int channel)
+            {
+#if defined(SO_PEERCRED)
+                ucred credentials{};
+                socklen_t length = sizeof(credentials);
+                return ::getsockopt(channel, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == ::geteuid();
+#else
+                uid_t uid;
+                gid_t gid;
+                return ::getpeereid(channel, &uid, &gid) == 0 && uid == ::geteuid();
+#endif
+            }
+
+            /// Send `fd` over the connected Unix socket `channel` (`SCM_RIGHTS`), the receiving process gets its own copy.
+            inline bool send_fd(int channel, int fd)
+            {
+                char byte = 'F';
+                iovec data{&byte, 1};
+                alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+                msghdr message{};
+                message.msg_iov = &data;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                cmsghdr* header = CMSG_FIRSTHDR(&message);
+                header->cmsg_level = SOL_SOCKET;
+                header->cmsg_type = SCM_RIGHTS;
+                header->cmsg_len = CMSG_LEN(sizeof(int));
+                std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+                int flags = 0;
+#ifdef MSG_NOSIGNAL
+                flags |= MSG_NOSIGNAL;
+#endif
+                ssize_t sent;
+                do
+                    sent = ::sendmsg(channel, &message, flags);
+                while (sent < 0 && errno == EINTR);
+                return sent == 1;
+            }
+
+            /// Ask the process serving handoffs on the Unix socket at `path` for its listening socket, -1 if there is no such process.
+            inline int receive_fd(const std::string& path)
+            {
+                sockaddr_un address{};
+                if (path.size() >= sizeof(address.sun_path))
+                {
+                    CROW_LOG_ERROR << "Socket handoff path is too long: " << path;
+                    return -1;
+                }
+                address.sun_family = AF_UNIX;
+                std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+                int channel = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if (channel < 0)
+                    return -1;
+                if (::connect(channel, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+                {
+                    // No file or nobody listening: there is no previous process to take over from
+                    if (errno != ENOENT && errno != ECONNREFUSED)
+                        CROW_LOG_WARNING << "Failed to connect to the socket handoff path " << path << ": " << std::strerror(errno);
+                    ::close(channel);
+                    return -1;
+                }
+                timeval timeout{5, 0};
+                ::setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+                char byte;
+                iovec data{&byte, 1};
+                alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+                msghdr message{};
+                message.msg_iov = &data;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+
+                int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+                flags |= MSG_CMSG_CLOEXEC;
+#endif
+                ssize_t received;
+                do
+                    received = ::recvmsg(channel, &message, flags);
+                while (received < 0 && errno == EINTR);
+                ::close(channel);
+
+                int fd = -1;
+                cmsghdr* header = received == 1 ? CMSG_FIRSTHDR(&message) : nullptr;
+                if (header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS && header->cmsg_len == CMSG_LEN(sizeof(int)))
+                    std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+                if (fd < 0)
+                    CROW_LOG_WARNING << "The process serving " << path << " didn't hand over its listening socket";
+                return fd;
+            }
+#else
+            constexpr bool supported = false;
+
+            inline int systemd_listen_fd() { return -1; }
+            inline bool same_user(int) { return false; }
+            inline bool send_fd(int, int) { return false; }
+            inline int receive_fd(const std::string&) { return -1; }
+#endif
+        } // namespace handoff
+    } // namespace detail
+} // namespace crow
@@ -0,0 +1,290 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "crow/http_request.h"
+#include "crow/http_response.h"
+#include "crow/logging.h"
+#include "crow/task_timer.h"
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    template<typename App>
+    class SSERule;
+
+    /**
+     * \namespace crow::sse
+     * \brief Namespace that includes the \ref connection class, used for Server-Sent Events.
+     *
+     * Used specially in crow/sse.h, crow/app.h and crow/routing.h
+     */
+    namespace sse
+    {
+        /// A client subscribed to a Server-Sent Events route.
+
+        ///
+        /// All methods can be called from any thread.
+        /// Events sent while an earlier write is still in progress are collected and sent together in a single write.
+        class connection : public std::enable_shared_from_this<connection>
+        {
+        public:
+            connection(const request& req, std::shared_ptr<response_stream> stream, std::function<void(connection&)> close_handler):
+              stream_(std::move(stream)),
+              close_handler_(std::move(close_handler)),
+              last_event_id_(req.get_header_value("Last-Event-ID")),
+              remote_ip_(req.remote_ip_address),
+              io_context_(req.io_context),
+              task_timer_(req.task_timer)
+            {}
+
+            connection(const connection&) = delete;
+            connection& operator=(const connection&) = delete;
+
+            /// Send an event, `id` and `event` are left out if empty.
+
+            ///
+            /// `data` may span several lines, the client receives it as it is.
+            void send_event(const std::string& id, const std::string& event, const std::string& data)
+            {
+                std::string text;
+                text.reserve(id.size() + event.size() + data.size() + 32);
+                if (!id.empty())
+                    append_field(text, "id: ", id);
+                if (!event.empty())
+                    append_field(text, "event: ", event);
+
+                // Every line of the data gets its own field, the client joins them back with '\n'
+                size_t begin = 0;
+                for (;;)
+                {
+                    size_t end = data.find_first_of("\r\n", begin);
+                    text += "data: ";
+                    text.append(data, begin, end == std::string::npos ? std::string::npos : end - begin);
+                    text += '\n';
+                    if (end == std::string::npos)
+                        break;
+                    begin = end + (data.compare(end, 2, "\r\n") == 0 ? 2 : 1);
+                }
+                text += '\n';
+                send(std::move(text));
+            }
+
+            /// Send an event with data only.
+            void send_event(const std::string& data)
+            {
+                send_event({}, {}, data);
+            }
+
+            /// Send a comment, which clients ignore (useful to keep proxies from timing out).
+            void send_comment(const std::string& comment)
+            {
+                std::string text;
+                append_field(text, ":", comment);
+                text += '\n';
+                send(std::move(text));
+            }
+
+            /// End the event stream once the events sent so far are out.
+            void close()
+            {
+                bool open = true;
+                if (!open_.compare_exchange_strong(open, false))
+                    return;
+
+                bool end_now;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    closing_ = true;
+                    end_now = !writing_;
+                }
+                if (end_now)
+                    stream_->end();
+                finish();
+            }
+
+            /// Whether events can still be sent.
+            bool is_open() const
+            {
+                return open_;
+            }
+
+            /// The id of the last event the client received before reconnecting (the `Last-Event-ID` header), empty on the first connection.
+            const std::string& last_event_id() const
+            {
+                return last_event_id_;
+            }
+
+            const std::string& get_remote_ip() const
+            {
+                return remote_ip_;
+            }
+
+            /// Number of bytes of events waiting for the previous write to complete.
+            size_t buffered_amount()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return pending_.size();
+            }
+
+            void userdata(void* u) { userdata_ = u; }
+            void* userdata() { return userdata_; }
+
+        private:
+            template<typename App>
+            friend class crow::SSERule;
+
+            static void append_field(std::string& text, const char* name, const std::string& value)
+            {
+                text += name;
+                // Line breaks would end the field early
+                for (char c : value)
+                    if (c != '\r' && c != '\n' && c != '\0')
+                        text += c;
+                text += '\n';
+            }
+
+            void send(std::string&& text)
+            {
+                if (!open_)
+                    return;
+                activity_ = true;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (writing_)
+                    {
+                        pending_ += text;
+                        return;
+                    }
+                    writing_ = true;
+                }
+                write(std::move(text));
+            }
+
+            void write(std::string&& text)
+            {
+                auto self = shared_from_this();
+                stream_->write(std::move(text), [self](bool sent) {
+                    self->on_written(sent);
+                });
+            }
+
+            /// Send whatever was collected during the previous write, or end the stream if it's closing.
+            void on_written(bool sent)
+            {
+                if (!sent)
+                {
+                    // The client is gone
+                    open_ = false;
+                    finish();
+                    return;
+                }
+
+                std::string batch;
+                bool end_now = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (pending_.empty())
+                    {
+                        writing_ = false;
+                        end_now = closing_;
+                    }
+                    else
+                    {
+                        batch.swap(pending_);
+                    }
+                }
+                if (!batch.empty())
+                    write(std::move(batch));
+                else if (end_now)
+                    stream_->end();
+            }
+
+            /// Send a comment every `interval` ticks of the worker's task timer, unless something else was sent in between.
+
+            ///
+            /// Since the connection doesn't read while the events are streamed, this is also how a client leaving gets noticed.
+            void start_heartbeat(uint8_t interval)
+            {
+                if (interval == 0 || !io_context_ || !task_timer_)
+                    return;
+
+                heartbeat_interval_ = interval;
+                auto self = shared_from_this();
+                asio::dispatch(*io_context_, [self] {
+                    self->schedule_heartbeat();
+                });
+            }
+
+            // The task timer belongs to the connection's thread, these only run there
+            void schedule_heartbeat()
+            {
+                if (!open_)
+                    return;
+                std::weak_ptr<connection> weak = shared_from_this();
+                auto heartbeat = [weak] {
+                    if (auto self = weak.lock())
+                    {
+                        self->heartbeat_scheduled_ = false;
+                        if (!self->activity_.exchange(false))
+                            self->send(":\n\n");
+                        self->schedule_heartbeat();
+                    }
+                };
+                heartbeat_id_ = task_timer_->schedule(heartbeat, heartbeat_interval_);
+                heartbeat_scheduled_ = true;
+            }
+
+            void cancel_heartbeat()
+            {
+                if (heartbeat_scheduled_)
+                {
+                    heartbeat_scheduled_ = false;
+                    task_timer_->cancel(heartbeat_id_);
+                }
+            }
+
+            /// Runs once, when the stream was closed by either side.
+            void finish()
+            {
+                bool finished = false;
+                if (!finished_.compare_exchange_strong(finished, true))
+                    return;
+
+                auto self = shared_from_this();
+                if (io_context_ && task_timer_)
+                {
+                    asio::dispatch(*io_context_, [self] {
+                        self->cancel_heartbeat();
+                    });
+                }
+                if (close_handler_)
+                    close_handler_(*this);
+            }
+
+        private:
+            std::shared_ptr<response_stream> stream_;
+            std::function<void(connection&)> close_handler_;
+            std::string last_event_id_;
+            std::string remote_ip_;
+            void* userdata_{};
+
+            std::mutex mutex_;
+            std::string pending_; ///< Events sent while a write was in progress.
+            bool writing_{};
+            bool closing_{};
+
+            std::atomic<bool> open_{true};
+            std::atomic<bool> finished_{false};
+            std::atomic<bool> activity_{false}; ///< Whether anything was sent since the last heartbeat.
+
+            asio::io_context* io_context_;
+            detail::task_timer* task_timer_;
+            detail::task_timer::identifier_type heartbeat_id_{};
+            uint8_t heartbeat_interval_{};
+            bool heartbeat_scheduled_{};
+        };
+    } // namespace sse
+} // namespace crow
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#define _CRT_INTERNAL_NONSTDC_NAMES 1
+#endif
+#include <sys/stat.h>
+#if !defined(S_ISREG) && defined(S_IFMT) && defined(S_IFREG)
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "crow/mime_types.h"
+#include "crow/utility.h"
+
+namespace crow // NOTE: Already documented in "crow/app.h"
+{
+    /// Counters of the static file cache, shared by all threads.
+    struct static_file_cache_stats
+    {
+        uint64_t hits;      ///< Lookups answered from the cache.
+        uint64_t misses;    ///< Lookups which had to `stat()` (and open) the file.
+        uint64_t evictions; ///< Entries dropped to keep a thread's cache within its size limit.
+    };
+
+    namespace detail
+    {
+        /// A read-only file descriptor, closed when the last owner lets go of it.
+        class file_handle
+        {
+        public:
+            explicit file_handle(const std::string& path)
+            {
+#if !defined(_WIN32)
+                fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#else
+                (void)path;
+#endif
+            }
+
+            file_handle(const file_handle&) = delete;
+            file_handle& operator=(const file_handle&) = delete;
+
+            ~file_handle()
+            {
+#if !defined(_WIN32)
+                if (fd_ >= 0)
+                    ::close(fd_);
+#endif
+            }
+
+            int fd() const
+            {
+                return fd_;
+            }
+
+        private:
+            int fd_ = -1;
+        };
+
+        /// Everything the server needs to know to serve a file, gathered once.
+        struct static_file_entry
+        {
+            struct stat statbuf;
+            int stat_result;
+            std::shared_ptr<const file_handle> file; ///< Open file, only kept for cached regular files (POSIX only).
+            std::string content_length;
+            std::string content_type; ///< Empty if the extension has no known mime type.
+            std::string last_modified;
+            std::string etag;
+            std::chrono::steady_clock::time_point expires;
+
+            bool is_regular_file() const
+            {
+                return stat_result == 0 && S_ISREG(statbuf.st_mode);
+            }
+        };
+
+        /// A bounded, least recently used cache of \ref static_file_entry objects.
+
+        ///
+        /// Each thread has its own cache (see \ref local()), so lookups never lock. A worker configures its own when it starts, the caches of other threads stay disabled.
+        /// An entry is used for at most the cache's time to live after the file was looked at, after which it is rebuilt from the file system.
+        class static_file_cache
+        {
+        public:
+            using entry_ptr = std::shared_ptr<const static_file_entry>;
+
+            /// The cache of the calling thread.
+            static static_file_cache& local()
+            {
+                thread_local static_file_cache cache;
+                return cache;
+            }
+
+            /// Keep up to `max_entries` entries in this cache, 0 disables caching, and trust each for `ttl` before looking at the file again.
+            void configure(size_t max_entries, std::chrono::milliseconds ttl)
+            {
+                max_entries_ = max_entries;
+                ttl_ = ttl;
+            }
+
+            static static_file_cache_stats stats()
+            {
+                return {counters().hits.load(std::memory_order_relaxed),
+                        counters().misses.load(std::memory_order_relaxed),
+                        counters().evictions.load(std::memory_order_relaxed)};
+            }
+
+            /// Get the entry for a (sanitized) path, looking at the file system only if the cached entry is missing or expired.
+            entry_ptr get(const std::string& path)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                if (max_entries_ == 0)
+                {
+                    entries_.clear();
+                    index_.clear();
+                    return make_entry(path, now, false);
+                }
+
+                auto found = index_.find(path);
+                if (found != index_.end())
+                {
+                    if (now < found->second->second->expires)
+                    {
+                        counters().hits.fetch_add(1, std::memory_order_relaxed);
+                        entries_.splice(entries_.begin(), entries_, found->second);
+                        return found->second->second;
+                    }
+                    entries_.erase(found->second);
+                    index_.erase(found);
+                }
+
+                counters().misses.fetch_add(1, std::memory_order_relaxed);
+                auto entry = make_entry(path, now, true);
+                entries_.emplace_front(path, entry);
+                index_.emplace(path, entries_.begin());
+
+                while (entries_.size() > max_entries_)
+                {
+                    index_.erase(entries_.back().first);
+                    entries_.pop_back();
+                    counters().evictions.fetch_add(1, std::memory_order_relaxed);
+                }
+                return entry;
+            }
+
+            /// Number of entries in this thread's cache.
+            size_t size() const
+            {
+                return entries_.size();
+            }
+
+        private:
+            struct counter_set
+            {
+                std::atomic<uint64_t> hits{0};
+                std::atomic<uint64_t> misses{0};
+                std::atomic<uint64_t> evictions{0};
+            };
+
+            static counter_set& counters()
+            {
+                static counter_set counters;
+                return counters;
+            }
+
+            entry_ptr make_entry(const std::string& path, std::chrono::steady_clock::time_point now, bool open_file) const
+            {
+                auto entry = std::make_shared<static_file_entry>();
+                entry->expires = now + ttl_;
+                entry->stat_result = stat(path.c_str(), &entry->statbuf);
+                if (!entry->is_regular_file())
+                    return entry;
+
+                if (open_file)
+                    entry->file = std::make_shared<file_handle>(path);
+                entry->content_length = std::to_string(entry->statbuf.st_size);
+
+                std::size_t last_dot = path.find_last_of('.');
+                if (last_dot != std::string::npos)
+                {
+                    auto mime_type = mime_types.find(path.substr(last_dot + 1));
+                    if (mime_type != mime_types.end())
+                        entry->content_type = mime_type->second;
+                }
+
+                std::time_t mtime = entry->statbuf.st_mtime;
+                entry->last_modified = utility::format_http_date(mtime);
+
+                // Same form as nginx: "<mtime>-<size>" in hex
+                char buf[64];
+                snprintf(buf, sizeof(buf), "\"%llx-%llx\"", static_cast<unsigned long long>(mtime), static_cast<unsigned long long>(entry->statbuf.st_size));
+                entry->etag = buf;
+                return entry;
+            }
+
+            using list_type = std::list<std::pair<std::string, entry_ptr>>;
+            list_type entries_; ///< Most recently used first.
+            std::unordered_map<std::string, list_type::iterator> index_;
+            size_t max_entries_ = 0;
+            std::chrono::milliseconds ttl_{std::chrono::seconds(1)};
+        };
+    } // namespace detail
+} // namespace crow
@@ -14,6 +14,7 @@
 #include <chrono>
 #include <functional>
 #include <map>
+#include <memory_resource>
 #include <vector>
 
 #include "crow/logging.h"
@@ -73,9 +74,9 @@ namespace crow
             /// It is not bound to this task_timer instance and in some cases
             /// could lead to undefined behavior if used with other task_timer
             /// objects or after the task has been successfully executed.
-            identifier_type schedule(const task_type& task)
+            identifier_type schedule(task_type task)
             {
-                return schedule(task, get_default_timeout());
+                return schedule(std::move(task), get_default_timeout());
             }
 
             /// Schedule the given task to be executed after the given time.
@@ -87,11 +88,11 @@ namespace crow
             /// It is not bound to this task_timer instance and in some cases
             /// could lead to undefined behavior if used with other task_timer
             /// objects or after the task has been successfully executed.
-            identifier_type schedule(const task_type& task, uint8_t timeout)
+            identifier_type schedule(task_type task, uint8_t timeout)
             {
-                tasks_.insert({++highest_id_,
-                               {clock_type::now() + (timeout * tick_length_ms_),
-                                task}});
+                tasks_.emplace(++highest_id_,
+                               std::make_pair(clock_type::now() + (timeout * tick_length_ms_),
+                                              std::move(task)));
                 CROW_LOG_DEBUG << "task_timer scheduled: " << this << ' ' <<
                                   highest_id_;
                 return highest_id_;
@@ -157,7 +158,9 @@ namespace crow
         private:
             asio::io_context& io_context_;
             asio::basic_waitable_timer<clock_type> timer_;
-            std::map<identifier_type, std::pair<time_type, task_type>> tasks_;
+            // The nodes of cancelled tasks are reused by the next ones (connections reschedule their deadline for every request)
+            std::pmr::unsynchronized_pool_resource task_memory_;
+            std::pmr::map<identifier_type, std::pair<time_type, task_type>> tasks_{&task_memory_};
 
             // A continuously increasing number to be issued to threads to
             // identify them. If no tasks are scheduled, it will be reset to 0.
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdlib>
 #include <stdexcept>
 #include <tuple>
 #include <type_traits>
 #include <cstring>
+#include <ctime>
 #include <cctype>
 #include <functional>
 #include <string>
@@ -885,6 +887,112 @@ namespace crow
             return result;
         }
 
+        /**
+         * @brief Finds the quality value a list header such as Accept-Encoding assigns to a token.
+         * @param header the header value (e.g. "gzip;q=0.8, br, *;q=0.1")
+         * @param token the token to look for (compared case-insensitively)
+         * @return the quality of the token (or of "*" if the token isn't listed), 0 if it isn't acceptable
+         */
+        inline static float header_token_quality(const std::string_view header, const std::string_view token)
+        {
+            float wildcard = 0;
+            size_t begin = 0;
+            while (begin < header.size())
+            {
+                size_t end = header.find(',', begin);
+                if (end == std::string_view::npos)
+                    end = header.size();
+                std::string_view element = header.substr(begin, end - begin);
+                begin = end + 1;
+
+                float quality = 1;
+                size_t semicolon = element.find(';');
+                if (semicolon != std::string_view::npos)
+                {
+                    std::string_view parameter = trim(element.substr(semicolon + 1));
+                    if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=')
+                        quality = std::strtof(std::string(parameter.substr(2)).c_str(), nullptr);
+                    element = element.substr(0, semicolon);
+                }
+                element = trim(element);
+
+                if (string_equals(element, token))
+                    return quality;
+                if (element == "*")
+                    wildcard = quality;
+            }
+            return wildcard;
+        }
+
+        /**
+         * @brief Parses an HTTP date in the preferred IMF-fixdate format (e.g. "Sun, 06 Nov 1994 08:49:37 GMT").
+         * @param date the date as found in a header such as If-Modified-Since
+         * @param time set to the seconds since the epoch if parsing succeeds
+         * @return false if the date isn't a valid IMF-fixdate
+         */
+        inline static bool parse_http_date(const std::string_view date, int64_t& time)
+        {
+            static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+            const std::string_view d = trim(date);
+            if (d.size() != 29 || d[3] != ',' || d[4] != ' ' || d[7] != ' ' || d[11] != ' ' || d[16] != ' ' ||
+                d[19] != ':' || d[22] != ':' || d[25] != ' ' || d.substr(26) != "GMT")
+                return false;
+
+            auto number = [&d](size_t pos, size_t length, int64_t& value) {
+                value = 0;
+                for (size_t i = pos; i < pos + length; i++)
+                {
+                    if (d[i] < '0' || d[i] > '9')
+                        return false;
+                    value = value * 10 + (d[i] - '0');
+                }
+                return true;
+            };
+
+            int64_t day, year, hour, minute, second;
+            if (!number(5, 2, day) || !number(12, 4, year) || !number(17, 2, hour) || !number(20, 2, minute) || !number(23, 2, second))
+                return false;
+
+            const char* month_pos = std::strstr(months, std::string(d.substr(8, 3)).c_str());
+            if (!month_pos || (month_pos - months) % 3 != 0)
+                return false;
+            int64_t month = (month_pos - months) / 3 + 1;
+            if (day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+                return false;
+
+            // Days since the epoch of a proleptic Gregorian date (http://howardhinnant.github.io/date_algorithms.html)
+            year -= month <= 2;
+            const int64_t era = year / 400;
+            const int64_t year_of_era = year - era * 400;
+            const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+            const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+            const int64_t days = era * 146097 + day_of_era - 719468;
+
+            time = days * 86400 + hour * 3600 + minute * 60 + second;
+            return true;
+        }
+
+        /**
+         * @brief Formats a time as an HTTP date in the IMF-fixdate format (e.g. "Sun, 06 Nov 1994 08:49:37 GMT").
+         * @param time the seconds since the epoch
+         * @return the date, with English day and month names whatever the C locale is
+         */
+        inline static std::string format_http_date(std::time_t time)
+        {
+            static const char days[] = "SunMonTueWedThuFriSat";
+            static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+            tm t;
+#if defined(_MSC_VER) || defined(__MINGW32__)
+            gmtime_s(&t, &time);
+#else
+            gmtime_r(&time, &t);
+#endif
+            char date[32];
+            int length = snprintf(date, sizeof(date), "%.3s, %02d %.3s %04d %02d:%02d:%02d GMT",
+                                  days + 3 * t.tm_wday, t.tm_mday, months + 3 * t.tm_mon, t.tm_year + 1900, t.tm_hour, t.tm_min, t.tm_sec);
+            return std::string(date, length);
+        }
+
         /**
          * @brief Returns the first occurence that matches between two ranges of iterators
          * @param first1 begin() iterator of the first range
@@ -167,9 +167,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     if (res)
                     {
                         std::vector<asio::const_buffer> buffers;
-                        auto server_name = "";
-                        std::string content_length_buffer;
-                        res->write_header_into_buffer(buffers, content_length_buffer, req.keep_alive, server_name);
+                        std::string header_block;
+                        res->write_header_into_buffer(buffers, header_block, req.keep_alive, std::string());
                         buffers.emplace_back(res->body.data(), res->body.size());
                         error_code ec;
                         asio::write(conn->adaptor_.socket(), buffers, ec);
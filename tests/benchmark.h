@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "catch2/catch_all.hpp"
+
+/// The measurements of a benchmark, shown together as a single warning by `show()`.
+
+///
+/// Benchmarks are hidden test cases, run them with `unittest [.benchmark]`.
+/// Each `measure()` adds a line with the time (and optionally the heap allocations) per unit of work, `note()` adds to that line.
+class benchmark_report
+{
+public:
+    /// `unit` names a unit of the work measured, such as "request".
+    explicit benchmark_report(std::string unit):
+      unit_(std::move(unit))
+    {}
+
+    /// Also report the allocations counted by `counter` (such as a replaced `operator new`) per unit.
+    void count_allocations(const std::atomic<size_t>& counter)
+    {
+        allocations_ = &counter;
+    }
+
+    /// Time `rounds` calls of `round` as the `variant`, each doing `units` times the work, return the time per unit in nanoseconds.
+    template<typename Round>
+    double measure(const std::string& variant, int rounds, Round&& round, size_t units = 1)
+    {
+        size_t allocations_before = allocations_ ? allocations_->load() : 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++)
+            round();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (static_cast<double>(rounds) * units);
+
+        line(variant + ": " + (ns < 10000 ? std::to_string(static_cast<long long>(ns)) + " ns/" : std::to_string(static_cast<long long>(ns / 1000)) + " us/") + unit_);
+        if (allocations_)
+            note(std::to_string(static_cast<double>(allocations_->load() - allocations_before) / (static_cast<double>(rounds) * units)) + " heap allocations/" + unit_);
+        return ns;
+    }
+
+    /// Add a line of its own.
+    void line(const std::string& text)
+    {
+        if (!text_.empty())
+            text_ += '\n';
+        text_ += text;
+    }
+
+    /// Add to the last line.
+    void note(const std::string& text)
+    {
+        text_ += ", " + text;
+    }
+
+    void show() const
+    {
+        WARN(text_);
+    }
+
+private:
+    std::string unit_;
+    const std::atomic<size_t>* allocations_ = nullptr;
+    std::string text_;
+};
@@ -6,6 +6,7 @@ struct DummyHandler {
     void handle_url() {}
     void handle_header() {}
     void handle() {}
+    bool handle_body(const char*, size_t) { return true; }
     size_t stream_threshold() { return 1024*1024; }
 };
 
@@ -31,8 +32,27 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 
     DummyHandler dummy;
     crow::HTTPParser<DummyHandler> parser(&dummy);
-    
-    if (parser.feed(reinterpret_cast<const char*>(data), size)) {
+
+    // The fast request head parser has to agree with the state machine
+    crow::HTTPParser<DummyHandler> other_parser(&dummy);
+    other_parser.fast_head = !parser.fast_head;
+    bool ok = parser.feed(reinterpret_cast<const char*>(data), size);
+    if (ok != other_parser.feed(reinterpret_cast<const char*>(data), size) ||
+        parser.consumed() != other_parser.consumed() ||
+        parser.message_done() != other_parser.message_done() ||
+        parser.req.method != other_parser.req.method ||
+        parser.req.raw_url != other_parser.req.raw_url ||
+        parser.req.url != other_parser.req.url ||
+        parser.req.headers != other_parser.req.headers ||
+        parser.req.body != other_parser.req.body)
+        __builtin_trap();
+    // Only set once the headers are complete
+    if (parser.message_done() &&
+        (parser.req.keep_alive != other_parser.req.keep_alive ||
+         parser.req.close_connection != other_parser.req.close_connection))
+        __builtin_trap();
+
+    if (ok) {
         parser.done();
         crow::response res;
         app.handle_full(parser.req, res);
@@ -1,6 +1,7 @@
 #include "catch2/catch_all.hpp"
 
 #include "crow.h"
+#include "../benchmark.h"
 
 using namespace crow;
 
@@ -44,4 +45,158 @@ TEST_CASE("simple_response")
     CHECK("text/html" == response(200, "html", "").get_header_value("Content-Type"));
     CHECK(500 == response(500, "html", "Internal Error?").code);
     CHECK("text/css" == response(500, "css", "Internal Error?").get_header_value("Content-Type"));
-}
\ No newline at end of file
+}
+
+static std::string joined(const std::vector<asio::const_buffer>& buffers)
+{
+    std::string all;
+    for (auto& buffer : buffers)
+        all.append(static_cast<const char*>(buffer.data()), buffer.size());
+    return all;
+}
+
+TEST_CASE("header_serialization")
+{
+    std::vector<asio::const_buffer> buffers;
+    std::string header_block;
+    const std::string server_header = "Server: Crow\r\n";
+    const std::string date_line = "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n";
+
+    response res(201, "{\"id\":1}");
+    res.set_header("Content-Type", "application/json");
+    res.write_header_into_buffer(buffers, header_block, true, server_header, &date_line);
+    CHECK(buffers.size() == 2); // The header block, then the shared Date line
+    CHECK(joined(buffers) == "HTTP/1.1 201 Created\r\n"
+                             "Content-Type: application/json\r\n"
+                             "Content-Length: 8\r\n"
+                             "Server: Crow\r\n"
+                             "Connection: Keep-Alive\r\n"
+                             "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n");
+
+    // The response's own Server and Date headers win
+    res = response(204);
+    res.set_header("Server", "mine");
+    res.set_header("Date", "today");
+    res.manual_length_header = true;
+    res.write_header_into_buffer(buffers, header_block, false, server_header, &date_line);
+    CHECK(buffers.size() == 1);
+    auto headers = joined(buffers);
+    CHECK(headers.find("HTTP/1.1 204 No Content\r\n") == 0);
+    CHECK(headers.find("Server: mine\r\n") != std::string::npos);
+    CHECK(headers.find("Date: today\r\n") != std::string::npos);
+    CHECK(headers.find("Crow") == std::string::npos);
+    CHECK(headers.find("Content-Length") == std::string::npos);
+    CHECK(headers.substr(headers.size() - 4) == "\r\n\r\n");
+
+    // Unknown status codes become 500
+    response unknown(299);
+    unknown.write_header_into_buffer(buffers, header_block, false, std::string());
+    CHECK(unknown.code == 500);
+    CHECK(joined(buffers) == "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 27\r\n\r\n");
+    CHECK(detail::status_line(404) == "HTTP/1.1 404 Not Found\r\n");
+    CHECK(detail::status_line(-1).empty());
+    CHECK(detail::status_line(1000).empty());
+} // header_serialization
+
+namespace
+{
+    /// Reference copy of `response::write_header_into_buffer()` before headers were serialized into one block, for the benchmark below.
+
+    ///
+    /// Status lines came from a hash map, each header took 4 buffers and Content-Length was formatted into a new string.
+    /// `date_line` is the Date header line alone (`Date: <IMF-fixdate>\r\n`), as the worker kept it then.
+    void scattered_write_header_into_buffer(response& res, std::vector<asio::const_buffer>& buffers, std::string& content_length_buffer, bool add_keep_alive, const std::string& server_name, const std::string* date_line)
+    {
+        static std::unordered_map<int, std::string> statusCodes = [] {
+            std::unordered_map<int, std::string> codes;
+            for (int code = 100; code < 600; code++)
+                if (!detail::status_line(code).empty())
+                    codes.emplace(code, std::string(detail::status_line(code)));
+            return codes;
+        }();
+        static const std::string seperator = ": ";
+        static const std::string crlf = "\r\n";
+
+        buffers.clear();
+        buffers.reserve(4 * (res.headers.size() + 5) + 3);
+
+        if (!statusCodes.count(res.code))
+            res.code = 500;
+
+        auto& status = statusCodes.find(res.code)->second;
+        buffers.emplace_back(status.data(), status.size());
+
+        if (res.code >= 400 && res.body.empty())
+            res.body = statusCodes[res.code].substr(9);
+
+        for (auto& kv : res.headers)
+        {
+            buffers.emplace_back(kv.first.data(), kv.first.size());
+            buffers.emplace_back(seperator.data(), seperator.size());
+            buffers.emplace_back(kv.second.data(), kv.second.size());
+            buffers.emplace_back(crlf.data(), crlf.size());
+        }
+
+        if (!res.manual_length_header && !res.headers.count("content-length"))
+        {
+            content_length_buffer = std::to_string(res.body.size());
+            static std::string content_length_tag = "Content-Length: ";
+            buffers.emplace_back(content_length_tag.data(), content_length_tag.size());
+            buffers.emplace_back(content_length_buffer.data(), content_length_buffer.size());
+            buffers.emplace_back(crlf.data(), crlf.size());
+        }
+        if (!res.headers.count("server") && !server_name.empty())
+        {
+            static std::string server_tag = "Server: ";
+            buffers.emplace_back(server_tag.data(), server_tag.size());
+            buffers.emplace_back(server_name.data(), server_name.size());
+            buffers.emplace_back(crlf.data(), crlf.size());
+        }
+        if (date_line && !res.headers.count("date"))
+        {
+            buffers.emplace_back(date_line->data(), date_line->size());
+        }
+        if (add_keep_alive)
+        {
+            static std::string keep_alive_tag = "Connection: Keep-Alive";
+            buffers.emplace_back(keep_alive_tag.data(), keep_alive_tag.size());
+            buffers.emplace_back(crlf.data(), crlf.size());
+        }
+
+        buffers.emplace_back(crlf.data(), crlf.size());
+    }
+} // namespace
+
+TEST_CASE("header_serialization_benchmark", "[.benchmark]")
+{
+    response res(200, R"({"message":"Hello, World!"})");
+    res.set_header("Content-Type", "application/json");
+    res.set_header("Cache-Control", "no-store");
+    const std::string server_name = "Crow/master";
+    const std::string server_header = "Server: " + server_name + "\r\n";
+    const std::string date_header = "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n";
+    const std::string date_line = date_header + "\r\n";
+    constexpr int iterations = 1000000;
+    benchmark_report report("response");
+
+    std::vector<asio::const_buffer> buffers;
+    std::string content_length;
+    report.measure("scattered pieces (before)", iterations, [&] {
+        scattered_write_header_into_buffer(res, buffers, content_length, true, server_name, &date_header);
+    });
+    const std::string scattered = joined(buffers);
+    report.note(std::to_string(buffers.size()) + " buffers");
+
+    std::string header_block;
+    report.measure("contiguous header block", iterations, [&] {
+        res.write_header_into_buffer(buffers, header_block, true, server_header, &date_line);
+    });
+    report.note(std::to_string(buffers.size()) + " buffers");
+
+    // The same headers, only the Date and Connection lines swap places
+    const std::string contiguous = joined(buffers);
+    CHECK(contiguous.size() == scattered.size());
+    CHECK(std::is_permutation(contiguous.begin(), contiguous.end(), scattered.begin()));
+    report.line("header bytes: " + std::to_string(contiguous.size()));
+    report.show();
+} // header_serialization_benchmark